@@ -0,0 +1,58 @@
+#include <benchmark/benchmark.h>
+
+#include <ulocal/http_header_table.hpp>
+
+using namespace ulocal;
+
+static HttpHeaderTable make_headers()
+{
+	HttpHeaderTable headers;
+	headers.add_header("Host", "localhost");
+	headers.add_header("User-Agent", "python-requests/2.22.0");
+	headers.add_header("Accept-Encoding", "gzip, deflate");
+	headers.add_header("Accept", "*/*");
+	headers.add_header("Connection", "keep-alive");
+	headers.add_header("X-Request-Id", "6f1c2a6e-5a1e-4bbf-9f1b-2b2f3c4d5e6f");
+	headers.add_header("Content-Type", "application/json");
+	headers.add_header("Content-Length", 29);
+	return headers;
+}
+
+static void BM_HttpHeaderTable_Build(benchmark::State& state)
+{
+	for (auto _ : state)
+		benchmark::DoNotOptimize(make_headers());
+}
+BENCHMARK(BM_HttpHeaderTable_Build);
+
+static void BM_HttpHeaderTable_LookupById(benchmark::State& state)
+{
+	auto headers = make_headers();
+	for (auto _ : state)
+		benchmark::DoNotOptimize(headers.get_header(HttpHeaderId::ContentLength));
+}
+BENCHMARK(BM_HttpHeaderTable_LookupById);
+
+static void BM_HttpHeaderTable_LookupKnownName(benchmark::State& state)
+{
+	auto headers = make_headers();
+	for (auto _ : state)
+		benchmark::DoNotOptimize(headers.get_header("content-length"));
+}
+BENCHMARK(BM_HttpHeaderTable_LookupKnownName);
+
+static void BM_HttpHeaderTable_LookupUnknownName(benchmark::State& state)
+{
+	auto headers = make_headers();
+	for (auto _ : state)
+		benchmark::DoNotOptimize(headers.get_header("x-request-id"));
+}
+BENCHMARK(BM_HttpHeaderTable_LookupUnknownName);
+
+static void BM_HttpHeaderTable_LookupMissing(benchmark::State& state)
+{
+	auto headers = make_headers();
+	for (auto _ : state)
+		benchmark::DoNotOptimize(headers.get_header("x-missing"));
+}
+BENCHMARK(BM_HttpHeaderTable_LookupMissing);
@@ -0,0 +1,80 @@
+#include <benchmark/benchmark.h>
+
+#include <ulocal/http_request_parser.hpp>
+#include <ulocal/http_response_parser.hpp>
+
+#include "corpus.hpp"
+
+using namespace ulocal;
+
+template <typename Parser>
+static void parse_whole(benchmark::State& state, const std::string& input)
+{
+	Parser parser;
+	for (auto _ : state)
+	{
+		StringStream stream(input);
+		auto result = parser.parse(stream);
+		benchmark::DoNotOptimize(result);
+	}
+	state.SetBytesProcessed(state.iterations() * input.length());
+}
+
+template <typename Parser>
+static void parse_fragmented(benchmark::State& state, const std::string& input)
+{
+	Parser parser;
+	for (auto _ : state)
+	{
+		StringStream stream(input.length());
+		for (std::size_t i = 0; i < input.length(); ++i)
+		{
+			stream.write_string(std::string_view{input.data() + i, 1});
+			auto result = parser.parse(stream);
+			benchmark::DoNotOptimize(result);
+		}
+	}
+	state.SetBytesProcessed(state.iterations() * input.length());
+}
+
+static void BM_HttpRequestParser_SmallGet(benchmark::State& state)
+{
+	parse_whole<HttpRequestParser>(state, corpus::small_get_request());
+}
+BENCHMARK(BM_HttpRequestParser_SmallGet);
+
+static void BM_HttpRequestParser_HeaderHeavy(benchmark::State& state)
+{
+	parse_whole<HttpRequestParser>(state, corpus::header_heavy_request());
+}
+BENCHMARK(BM_HttpRequestParser_HeaderHeavy);
+
+static void BM_HttpRequestParser_LargeBody(benchmark::State& state)
+{
+	parse_whole<HttpRequestParser>(state, corpus::large_body_request(state.range(0)));
+}
+BENCHMARK(BM_HttpRequestParser_LargeBody)->Range(1 << 10, 1 << 20);
+
+static void BM_HttpRequestParser_Fragmented(benchmark::State& state)
+{
+	parse_fragmented<HttpRequestParser>(state, corpus::header_heavy_request());
+}
+BENCHMARK(BM_HttpRequestParser_Fragmented);
+
+static void BM_HttpResponseParser_Small(benchmark::State& state)
+{
+	parse_whole<HttpResponseParser>(state, corpus::small_response());
+}
+BENCHMARK(BM_HttpResponseParser_Small);
+
+static void BM_HttpResponseParser_LargeBody(benchmark::State& state)
+{
+	parse_whole<HttpResponseParser>(state, corpus::large_body_response(state.range(0)));
+}
+BENCHMARK(BM_HttpResponseParser_LargeBody)->Range(1 << 10, 1 << 20);
+
+static void BM_HttpResponseParser_Fragmented(benchmark::State& state)
+{
+	parse_fragmented<HttpResponseParser>(state, corpus::small_response());
+}
+BENCHMARK(BM_HttpResponseParser_Fragmented);
@@ -0,0 +1,40 @@
+#include <functional>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include <ulocal/route_table.hpp>
+
+using namespace ulocal;
+
+using Callback = std::function<int(int)>;
+
+static RouteTable<Callback> make_routes(std::size_t count)
+{
+	RouteTable<Callback> routes;
+	for (std::size_t i = 0; i < count; ++i)
+		routes.add_route("/api/v1/resource" + std::to_string(i), std::initializer_list<std::string>{"GET", "POST"}, [i](int x) { return x + static_cast<int>(i); });
+	return routes;
+}
+
+static void BM_RouteTable_Dispatch(benchmark::State& state)
+{
+	auto routes = make_routes(state.range(0));
+	std::string route = "/api/v1/resource" + std::to_string(state.range(0) / 2);
+	std::string method = "GET";
+	for (auto _ : state)
+	{
+		if (routes.has_route_for_method(route, method))
+			benchmark::DoNotOptimize(routes.perform_action(route, method, 1));
+	}
+}
+BENCHMARK(BM_RouteTable_Dispatch)->Arg(4)->Arg(64);
+
+static void BM_RouteTable_Miss(benchmark::State& state)
+{
+	auto routes = make_routes(state.range(0));
+	std::string route = "/api/v1/missing";
+	for (auto _ : state)
+		benchmark::DoNotOptimize(routes.has_route(route));
+}
+BENCHMARK(BM_RouteTable_Miss)->Arg(4)->Arg(64);
@@ -0,0 +1,53 @@
+#include <benchmark/benchmark.h>
+
+#include <ulocal/http_request.hpp>
+#include <ulocal/http_response.hpp>
+
+using namespace ulocal;
+
+static void add_server_headers(HttpResponse& response)
+{
+	response.calculate_content_length();
+	response.add_header(HttpHeaderId::Server, "benchmark");
+	response.add_header(HttpHeaderId::Connection, "close");
+	response.add_header("X-Framework", "ulocal");
+}
+
+static void BM_HttpResponse_DumpSmall(benchmark::State& state)
+{
+	HttpResponse response{200, std::string{"{\"status\": \"ok\"}"}};
+	add_server_headers(response);
+	for (auto _ : state)
+		benchmark::DoNotOptimize(response.dump());
+}
+BENCHMARK(BM_HttpResponse_DumpSmall);
+
+static void BM_HttpResponse_DumpCustomReason(benchmark::State& state)
+{
+	HttpResponse response{200, std::string{"Fine"}, HttpHeaderTable{}, std::string{"{}"}};
+	add_server_headers(response);
+	for (auto _ : state)
+		benchmark::DoNotOptimize(response.dump());
+}
+BENCHMARK(BM_HttpResponse_DumpCustomReason);
+
+static void BM_HttpResponse_DumpLarge(benchmark::State& state)
+{
+	HttpResponse response{200, std::string(state.range(0), 'x')};
+	add_server_headers(response);
+	for (auto _ : state)
+		benchmark::DoNotOptimize(response.dump());
+	state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HttpResponse_DumpLarge)->Range(1 << 10, 1 << 20);
+
+static void BM_HttpRequest_Dump(benchmark::State& state)
+{
+	HttpRequest request{"POST", "/api/v1/inventory?filter=active&limit=100", std::string{"{}"}};
+	request.add_header(HttpHeaderId::Host, "localhost");
+	request.add_header(HttpHeaderId::ContentType, "application/json");
+	request.calculate_content_length();
+	for (auto _ : state)
+		benchmark::DoNotOptimize(request.dump());
+}
+BENCHMARK(BM_HttpRequest_Dump);
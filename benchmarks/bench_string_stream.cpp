@@ -0,0 +1,59 @@
+#include <benchmark/benchmark.h>
+
+#include <ulocal/string_stream.hpp>
+
+#include "corpus.hpp"
+
+using namespace ulocal;
+
+static void BM_StringStream_ReadUntilChar(benchmark::State& state)
+{
+	auto input = corpus::header_heavy_request();
+	for (auto _ : state)
+	{
+		StringStream stream(input);
+		while (stream.get_size() > 0)
+		{
+			auto [str, found] = stream.read_until(':');
+			benchmark::DoNotOptimize(str);
+			if (!found)
+				break;
+			stream.skip(1);
+		}
+	}
+	state.SetBytesProcessed(state.iterations() * input.length());
+}
+BENCHMARK(BM_StringStream_ReadUntilChar);
+
+static void BM_StringStream_ReadUntilString(benchmark::State& state)
+{
+	auto input = corpus::header_heavy_request();
+	for (auto _ : state)
+	{
+		StringStream stream(input);
+		while (stream.get_size() > 0)
+		{
+			auto [str, found] = stream.read_until("\r\n");
+			benchmark::DoNotOptimize(str);
+			if (!found)
+				break;
+			stream.skip(2);
+		}
+	}
+	state.SetBytesProcessed(state.iterations() * input.length());
+}
+BENCHMARK(BM_StringStream_ReadUntilString);
+
+static void BM_StringStream_ReadUntilPartialDelimiter(benchmark::State& state)
+{
+	std::string input(state.range(0), 'x');
+	input += '\r';
+	for (auto _ : state)
+	{
+		StringStream stream(input);
+		auto result = stream.read_until("\r\n");
+		benchmark::DoNotOptimize(result);
+	}
+	state.SetBytesProcessed(state.iterations() * input.length());
+}
+BENCHMARK(BM_StringStream_ReadUntilPartialDelimiter)->Range(64, 1 << 16);
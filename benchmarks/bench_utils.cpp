@@ -0,0 +1,94 @@
+#include <cctype>
+
+#include <benchmark/benchmark.h>
+
+#include <ulocal/utils.hpp>
+
+using namespace ulocal;
+
+namespace {
+
+// Implementations before the switch to ASCII-only word-at-a-time folding, kept for comparison
+std::size_t legacy_icase_hash(const std::string& str)
+{
+	std::size_t seed = 0;
+	for (auto c : str)
+		hash_combine(seed, std::tolower(c));
+	return seed;
+}
+
+bool legacy_icase_compare(const std::string& str1, const std::string& str2)
+{
+	return std::equal(
+		std::begin(str1), std::end(str1),
+		std::begin(str2), std::end(str2),
+		[](auto c1, auto c2) { return std::tolower(c1) == std::tolower(c2); }
+	);
+}
+
+const std::string header_name = "Content-Length";
+const std::string header_name_lower = "content-length";
+const std::string route = "/api/v1/inventory/items/details";
+
+std::string make_blob(std::size_t size)
+{
+	std::string result;
+	result.reserve(size);
+	for (std::size_t i = 0; i < size; ++i)
+		result += (i % 64 == 63) ? ' ' : static_cast<char>('a' + i % 26);
+	return result;
+}
+
+}
+
+static void BM_IcaseHash(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(icase_hash(header_name));
+		benchmark::DoNotOptimize(icase_hash(route));
+	}
+}
+BENCHMARK(BM_IcaseHash);
+
+static void BM_IcaseHash_Legacy(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(legacy_icase_hash(header_name));
+		benchmark::DoNotOptimize(legacy_icase_hash(route));
+	}
+}
+BENCHMARK(BM_IcaseHash_Legacy);
+
+static void BM_IcaseEqual(benchmark::State& state)
+{
+	for (auto _ : state)
+		benchmark::DoNotOptimize(icase_equal(header_name, header_name_lower));
+}
+BENCHMARK(BM_IcaseEqual);
+
+static void BM_IcaseEqual_Legacy(benchmark::State& state)
+{
+	for (auto _ : state)
+		benchmark::DoNotOptimize(legacy_icase_compare(header_name, header_name_lower));
+}
+BENCHMARK(BM_IcaseEqual_Legacy);
+
+static void BM_UrlEncode(benchmark::State& state)
+{
+	auto input = make_blob(state.range(0));
+	for (auto _ : state)
+		benchmark::DoNotOptimize(url_encode(input));
+	state.SetBytesProcessed(state.iterations() * input.length());
+}
+BENCHMARK(BM_UrlEncode)->Range(16, 1 << 16);
+
+static void BM_UrlDecode(benchmark::State& state)
+{
+	auto input = url_encode(make_blob(state.range(0)));
+	for (auto _ : state)
+		benchmark::DoNotOptimize(url_decode(input));
+	state.SetBytesProcessed(state.iterations() * input.length());
+}
+BENCHMARK(BM_UrlDecode)->Range(16, 1 << 16);
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#ifdef ULOCAL_COMPRESSION
+#include <stdexcept>
+
+#include <zlib.h>
+#endif
+
+#include <ulocal/http_message.hpp>
+#include <ulocal/key_value.hpp>
+#include <ulocal/utils.hpp>
+
+namespace ulocal {
+
+enum class ContentEncoding
+{
+	Identity,
+	Gzip,
+	Deflate
+};
+
+inline std::string_view get_content_encoding_name(ContentEncoding encoding)
+{
+	switch (encoding)
+	{
+		case ContentEncoding::Gzip:
+			return "gzip";
+		case ContentEncoding::Deflate:
+			return "deflate";
+		default:
+			return "identity";
+	}
+}
+
+inline std::optional<ContentEncoding> get_content_encoding(std::string_view name)
+{
+	name = strip(name);
+	if (icase_equal(name, "gzip") || icase_equal(name, "x-gzip"))
+		return ContentEncoding::Gzip;
+	else if (icase_equal(name, "deflate"))
+		return ContentEncoding::Deflate;
+	else if (icase_equal(name, "identity"))
+		return ContentEncoding::Identity;
+	return std::nullopt;
+}
+
+// Picks the encoding from Accept-Encoding header, gzip is preferred over deflate when the client ranks them the same
+inline ContentEncoding negotiate_content_encoding(std::string_view accept_encoding)
+{
+	auto result = ContentEncoding::Identity;
+	double best_quality = 0.0;
+	std::optional<double> wildcard_quality;
+	bool gzip_listed = false, deflate_listed = false;
+
+	while (!accept_encoding.empty())
+	{
+		auto comma = accept_encoding.find(',');
+		auto item = accept_encoding.substr(0, comma);
+		accept_encoding = comma == std::string_view::npos ? std::string_view{} : accept_encoding.substr(comma + 1);
+
+		double quality = 1.0;
+		auto semicolon = item.find(';');
+		if (semicolon != std::string_view::npos)
+		{
+			auto parameter = strip(item.substr(semicolon + 1));
+			if (parameter.length() > 2 && (parameter[0] == 'q' || parameter[0] == 'Q') && parameter[1] == '=')
+				quality = detail::ValueGetter<double>::convert(parameter.substr(2)).value_or(0.0);
+			item = item.substr(0, semicolon);
+		}
+
+		item = strip(item);
+		if (item == "*")
+		{
+			wildcard_quality = quality;
+			continue;
+		}
+
+		auto encoding = get_content_encoding(item);
+		if (!encoding || encoding == ContentEncoding::Identity)
+			continue;
+
+		(encoding == ContentEncoding::Gzip ? gzip_listed : deflate_listed) = true;
+		if (quality > best_quality || (quality == best_quality && quality > 0.0 && encoding == ContentEncoding::Gzip))
+		{
+			result = encoding.value();
+			best_quality = quality;
+		}
+	}
+
+	// Wildcard only covers the encodings which are not listed explicitly
+	if (wildcard_quality && wildcard_quality.value() > best_quality)
+	{
+		if (!gzip_listed)
+			result = ContentEncoding::Gzip;
+		else if (!deflate_listed)
+			result = ContentEncoding::Deflate;
+	}
+
+	return result;
+}
+
+#ifdef ULOCAL_COMPRESSION
+
+class CompressionError : public std::exception
+{
+public:
+	CompressionError(const char* msg) noexcept : _msg(msg) {}
+
+	virtual const char* what() const noexcept { return _msg; }
+
+private:
+	const char* _msg;
+};
+
+namespace detail {
+
+// zlib streams are expensive to set up so every thread keeps one per encoding and only resets it between messages
+class Deflater
+{
+public:
+	Deflater(ContentEncoding encoding, int level) : _stream(), _level(level)
+	{
+		// Window bits over 15 produce gzip wrapper while plain 15 produces zlib wrapper which HTTP calls deflate
+		if (::deflateInit2(&_stream, level, Z_DEFLATED, encoding == ContentEncoding::Gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			throw CompressionError("Unable to initialize compression");
+	}
+
+	Deflater(const Deflater&) = delete;
+	Deflater& operator=(const Deflater&) = delete;
+
+	~Deflater()
+	{
+		::deflateEnd(&_stream);
+	}
+
+	std::string compress(std::string_view data, int level)
+	{
+		::deflateReset(&_stream);
+		if (level != _level)
+		{
+			::deflateParams(&_stream, level, Z_DEFAULT_STRATEGY);
+			_level = level;
+		}
+
+		std::string result(::deflateBound(&_stream, data.length()), '\0');
+		_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+		_stream.avail_in = static_cast<uInt>(data.length());
+		_stream.next_out = reinterpret_cast<Bytef*>(result.data());
+		_stream.avail_out = static_cast<uInt>(result.length());
+
+		if (::deflate(&_stream, Z_FINISH) != Z_STREAM_END)
+			throw CompressionError("Unable to compress data");
+
+		result.resize(_stream.total_out);
+		return result;
+	}
+
+private:
+	z_stream _stream;
+	int _level;
+};
+
+class Inflater
+{
+public:
+	Inflater() : _stream()
+	{
+		// Detects gzip and zlib wrapper automatically
+		if (::inflateInit2(&_stream, 15 + 32) != Z_OK)
+			throw CompressionError("Unable to initialize decompression");
+	}
+
+	Inflater(const Inflater&) = delete;
+	Inflater& operator=(const Inflater&) = delete;
+
+	~Inflater()
+	{
+		::inflateEnd(&_stream);
+	}
+
+	std::string decompress(std::string_view data, std::size_t max_length)
+	{
+		::inflateReset(&_stream);
+
+		std::string result;
+		char buffer[16384];
+		_stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+		_stream.avail_in = static_cast<uInt>(data.length());
+
+		int status = Z_OK;
+		while (status != Z_STREAM_END)
+		{
+			_stream.next_out = reinterpret_cast<Bytef*>(buffer);
+			_stream.avail_out = sizeof(buffer);
+			status = ::inflate(&_stream, Z_NO_FLUSH);
+			if (status != Z_OK && status != Z_STREAM_END)
+				throw CompressionError("Unable to decompress data");
+			else if (status == Z_OK && _stream.avail_in == 0 && _stream.avail_out != 0)
+				throw CompressionError("Compressed data are truncated");
+
+			// Small input can expand enormously so the output has to be limited before it exhausts the memory
+			if (sizeof(buffer) - _stream.avail_out > max_length - result.length())
+				throw CompressionError("Decompressed data are too large");
+			result.append(buffer, sizeof(buffer) - _stream.avail_out);
+		}
+
+		return result;
+	}
+
+private:
+	z_stream _stream;
+};
+
+} // namespace detail
+
+inline std::string compress(std::string_view data, ContentEncoding encoding, int level = Z_DEFAULT_COMPRESSION)
+{
+	if (encoding == ContentEncoding::Identity)
+		return std::string{data};
+
+	thread_local detail::Deflater gzip{ContentEncoding::Gzip, Z_DEFAULT_COMPRESSION};
+	thread_local detail::Deflater deflate{ContentEncoding::Deflate, Z_DEFAULT_COMPRESSION};
+	return (encoding == ContentEncoding::Gzip ? gzip : deflate).compress(data, level);
+}
+
+// Raises CompressionError once the decompressed data would be longer than max_length
+inline std::string decompress(std::string_view data, ContentEncoding encoding, std::size_t max_length = std::numeric_limits<std::size_t>::max())
+{
+	if (encoding == ContentEncoding::Identity)
+	{
+		if (data.length() > max_length)
+			throw CompressionError("Decompressed data are too large");
+		return std::string{data};
+	}
+
+	thread_local detail::Inflater inflater;
+	return inflater.decompress(data, max_length);
+}
+
+// Replaces the content encoded according to Content-Encoding by the decoded one, unknown encodings are left untouched
+inline void decompress_content(HttpMessage& message, std::size_t max_length = std::numeric_limits<std::size_t>::max())
+{
+	auto header = message.get_header(HttpHeaderId::ContentEncoding);
+	if (!header)
+		return;
+
+	auto encoding = get_content_encoding(header->get_value());
+	if (!encoding)
+		return;
+
+	message.set_content(decompress(message.get_content(), encoding.value(), max_length));
+	message.remove_header(get_header_name(HttpHeaderId::ContentEncoding));
+	message.remove_header(get_header_name(HttpHeaderId::ContentLength));
+	message.calculate_content_length();
+}
+
+#endif
+
+} // namespace ulocal
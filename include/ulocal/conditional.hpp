@@ -0,0 +1,210 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <ctime>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include <ulocal/http_request.hpp>
+#include <ulocal/http_response.hpp>
+#include <ulocal/key_value.hpp>
+#include <ulocal/utils.hpp>
+
+namespace ulocal {
+
+namespace detail {
+
+constexpr std::array<std::string_view, 7> http_date_days = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+constexpr std::array<std::string_view, 12> http_date_months = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+inline void append_padded(std::string& str, int number, std::size_t width)
+{
+	auto digits = std::to_string(number);
+	if (digits.length() < width)
+		str.append(width - digits.length(), '0');
+	str.append(digits);
+}
+
+inline std::optional<int> parse_fixed_number(std::string_view str, std::size_t pos, std::size_t width)
+{
+	if (pos + width > str.length())
+		return std::nullopt;
+
+	int result = 0;
+	for (std::size_t i = pos; i < pos + width; ++i)
+	{
+		if (str[i] < '0' || str[i] > '9')
+			return std::nullopt;
+		result = result * 10 + (str[i] - '0');
+	}
+	return result;
+}
+
+// Compares entity tags the weak way, W/ prefix is ignored on both sides
+inline bool weak_etag_equal(std::string_view etag1, std::string_view etag2)
+{
+	if (etag1.substr(0, 2) == "W/")
+		etag1.remove_prefix(2);
+	if (etag2.substr(0, 2) == "W/")
+		etag2.remove_prefix(2);
+	return etag1 == etag2;
+}
+
+} // namespace detail
+
+// Formats the time as IMF-fixdate used by Last-Modified and Date headers, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+inline std::string format_http_date(std::chrono::system_clock::time_point time)
+{
+	auto seconds = std::chrono::system_clock::to_time_t(time);
+	std::tm tm;
+	::gmtime_r(&seconds, &tm);
+
+	std::string result;
+	result.reserve(29);
+	result.append(detail::http_date_days[tm.tm_wday]);
+	result.append(", ");
+	detail::append_padded(result, tm.tm_mday, 2);
+	result.push_back(' ');
+	result.append(detail::http_date_months[tm.tm_mon]);
+	result.push_back(' ');
+	detail::append_padded(result, tm.tm_year + 1900, 4);
+	result.push_back(' ');
+	detail::append_padded(result, tm.tm_hour, 2);
+	result.push_back(':');
+	detail::append_padded(result, tm.tm_min, 2);
+	result.push_back(':');
+	detail::append_padded(result, tm.tm_sec, 2);
+	result.append(" GMT");
+	return result;
+}
+
+// Only IMF-fixdate is accepted, obsolete date formats are treated as invalid which makes the condition ignored
+inline std::optional<std::chrono::system_clock::time_point> parse_http_date(std::string_view str)
+{
+	str = strip(str);
+	if (str.length() != 29 || str.substr(3, 2) != ", " || str[7] != ' ' || str[11] != ' ' || str[16] != ' ' || str[19] != ':' || str[22] != ':' || str.substr(25) != " GMT")
+		return std::nullopt;
+
+	std::tm tm = {};
+	tm.tm_mon = -1;
+	for (std::size_t i = 0; i < detail::http_date_months.size(); ++i)
+	{
+		if (str.substr(8, 3) == detail::http_date_months[i])
+			tm.tm_mon = static_cast<int>(i);
+	}
+
+	auto day = detail::parse_fixed_number(str, 5, 2);
+	auto year = detail::parse_fixed_number(str, 12, 4);
+	auto hour = detail::parse_fixed_number(str, 17, 2);
+	auto minute = detail::parse_fixed_number(str, 20, 2);
+	auto second = detail::parse_fixed_number(str, 23, 2);
+	if (tm.tm_mon < 0 || !day || !year || !hour || !minute || !second || day.value() < 1 || day.value() > 31 || hour.value() > 23 || minute.value() > 59 || second.value() > 60)
+		return std::nullopt;
+
+	tm.tm_mday = day.value();
+	tm.tm_year = year.value() - 1900;
+	tm.tm_hour = hour.value();
+	tm.tm_min = minute.value();
+	tm.tm_sec = second.value();
+	return std::chrono::system_clock::from_time_t(::timegm(&tm));
+}
+
+// Cheap description of the current state of the resource which is known before the response is built, usually
+// a version or a hash of the underlying data and its modification time. At least one of them should be set.
+struct ResponseValidator
+{
+	// Opaque tag without quotes, it's quoted when put into ETag header
+	std::optional<std::string> etag;
+	// Weak tags only claim semantic equivalence, e.g. when the same data can be rendered slightly differently
+	bool weak = false;
+	std::optional<std::chrono::system_clock::time_point> last_modified;
+
+	std::optional<std::string> get_etag_header() const
+	{
+		if (!etag)
+			return std::nullopt;
+
+		std::string result;
+		result.reserve(etag->length() + 4);
+		if (weak)
+			result.append("W/");
+		result.push_back('"');
+		result.append(etag.value());
+		result.push_back('"');
+		return result;
+	}
+
+	// Adds ETag and Last-Modified headers unless the response already has them
+	void apply(HttpResponse& response) const
+	{
+		if (auto etag_header = get_etag_header(); etag_header && !response.has_header(HttpHeaderId::ETag))
+			response.add_header(HttpHeaderId::ETag, std::move(etag_header).value());
+		if (last_modified && !response.has_header(HttpHeaderId::LastModified))
+			response.add_header(HttpHeaderId::LastModified, format_http_date(last_modified.value()));
+	}
+};
+
+// Makes strong ETag of the response weak, e.g. when its content is transformed by content coding and is no longer
+// byte-for-byte identical to the representation the tag was computed for
+inline void weaken_etag(HttpResponse& response)
+{
+	auto etag = response.get_header(HttpHeaderId::ETag);
+	if (!etag || etag->get_value().compare(0, 2, "W/") == 0)
+		return;
+
+	auto weak_etag = "W/" + etag->get_value();
+	response.remove_header(get_header_name(HttpHeaderId::ETag));
+	response.add_header(HttpHeaderId::ETag, std::move(weak_etag));
+}
+
+// Checks whether the client already has the current representation of the resource according to If-None-Match
+// and If-Modified-Since (RFC 7232). If-None-Match takes precedence and only GET and HEAD requests are considered.
+inline bool is_not_modified(const HttpRequest& request, const ResponseValidator& validator)
+{
+	if (!icase_equal(request.get_method(), "GET") && !icase_equal(request.get_method(), "HEAD"))
+		return false;
+
+	if (auto if_none_match = request.get_header(HttpHeaderId::IfNoneMatch))
+	{
+		auto etag = validator.get_etag_header();
+		if (!etag)
+			return false;
+
+		std::string_view value = if_none_match->get_value();
+		if (strip(value) == "*")
+			return true;
+
+		// Entity tags are quoted and can contain commas so the list is split on the quotes
+		while (!value.empty())
+		{
+			value = strip(value);
+			auto start = value.find('"');
+			if (start == std::string_view::npos)
+				break;
+			auto end = value.find('"', start + 1);
+			if (end == std::string_view::npos)
+				break;
+
+			if (detail::weak_etag_equal(strip(value.substr(0, end + 1)), etag.value()))
+				return true;
+
+			value = value.substr(end + 1);
+			auto comma = value.find(',');
+			value = comma == std::string_view::npos ? std::string_view{} : value.substr(comma + 1);
+		}
+
+		return false;
+	}
+
+	if (auto if_modified_since = request.get_header(HttpHeaderId::IfModifiedSince); if_modified_since && validator.last_modified)
+	{
+		auto since = parse_http_date(if_modified_since->get_value());
+		return since && std::chrono::time_point_cast<std::chrono::seconds>(validator.last_modified.value()) <= since.value();
+	}
+
+	return false;
+}
+
+} // namespace ulocal
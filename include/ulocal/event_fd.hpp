@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace ulocal {
+
+// Counter which wakes up the thread polling on it whenever it's notified
+class EventFd
+{
+public:
+	EventFd() : _fd(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+	{
+		if (_fd < 0)
+			throw std::runtime_error("Unable to create eventfd");
+	}
+
+	EventFd(const EventFd&) = delete;
+	EventFd& operator=(const EventFd&) = delete;
+
+	~EventFd()
+	{
+		::close(_fd);
+	}
+
+	int get_fd() const { return _fd; }
+
+	void notify()
+	{
+		std::uint64_t value = 1;
+		// Counter can only overflow when nobody consumes it and then the poller is woken up anyway
+		[[maybe_unused]] auto result = ::write(_fd, &value, sizeof(value));
+	}
+
+	void consume()
+	{
+		std::uint64_t value;
+		[[maybe_unused]] auto result = ::read(_fd, &value, sizeof(value));
+	}
+
+private:
+	int _fd;
+};
+
+} // namespace ulocal
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ulocal {
+
+// Owning wrapper of file descriptor, copies are duplicates of the descriptor referring to the same open file
+class FileDescriptor
+{
+public:
+	FileDescriptor() noexcept : _fd(-1) {}
+	explicit FileDescriptor(int fd) noexcept : _fd(fd) {}
+
+	FileDescriptor(const FileDescriptor& rhs) : _fd(duplicate(rhs._fd)) {}
+	FileDescriptor(FileDescriptor&& rhs) noexcept : _fd(std::exchange(rhs._fd, -1)) {}
+
+	~FileDescriptor()
+	{
+		reset();
+	}
+
+	FileDescriptor& operator=(const FileDescriptor& rhs)
+	{
+		if (this != &rhs)
+			reset(duplicate(rhs._fd));
+		return *this;
+	}
+
+	FileDescriptor& operator=(FileDescriptor&& rhs) noexcept
+	{
+		if (this != &rhs)
+			reset(std::exchange(rhs._fd, -1));
+		return *this;
+	}
+
+	int get() const { return _fd; }
+	bool is_valid() const { return _fd >= 0; }
+	explicit operator bool() const { return is_valid(); }
+
+	// Gives up the ownership, caller is responsible for closing the returned descriptor
+	int release() noexcept
+	{
+		return std::exchange(_fd, -1);
+	}
+
+	void reset(int fd = -1) noexcept
+	{
+		if (_fd >= 0)
+			::close(_fd);
+		_fd = fd;
+	}
+
+private:
+	static int duplicate(int fd)
+	{
+		if (fd < 0)
+			return -1;
+
+		auto result = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+		if (result < 0)
+			throw std::runtime_error("Unable to duplicate file descriptor");
+		return result;
+	}
+
+	int _fd;
+};
+
+} // namespace ulocal
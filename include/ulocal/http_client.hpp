@@ -1,14 +1,20 @@
 #pragma once
 
+#include <limits>
+#include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <poll.h>
 
+#include <ulocal/compression.hpp>
 #include <ulocal/http_header_table.hpp>
 #include <ulocal/http_request.hpp>
 #include <ulocal/http_response.hpp>
 #include <ulocal/http_response_parser.hpp>
+#include <ulocal/loopback.hpp>
+#include <ulocal/shared_body.hpp>
 #include <ulocal/socket.hpp>
 
 namespace ulocal {
@@ -27,7 +33,35 @@ private:
 class HttpClient
 {
 public:
-	HttpClient(const std::string& local_socket_path) : _local_socket_path(local_socket_path) {}
+	static constexpr std::size_t DefaultMaxContentLength = 256 * 1024 * 1024;
+
+	HttpClient(const std::string& local_socket_path) : _local_socket_path(local_socket_path), _loopback(nullptr), _listener(0), _shared_body_threshold(0), _max_content_length(DefaultMaxContentLength), _validator_cache_size(0), _validator_cache() {}
+
+	// Sends requests directly to the server in the same process, the server has to outlive the client
+	HttpClient(LoopbackTransport& server, std::size_t listener = 0) : _local_socket_path(), _loopback(&server), _listener(listener), _shared_body_threshold(0), _max_content_length(DefaultMaxContentLength), _validator_cache_size(0), _validator_cache() {}
+
+	// Responses with shared or compressed content larger than this are rejected, zero disables the limit
+	void set_max_content_length(std::size_t max_content_length)
+	{
+		_max_content_length = max_content_length;
+	}
+
+	// Request bodies of at least this size are passed to the server in shared memory and the server is allowed
+	// to do the same with the response bodies, zero disables it. Both sides need to support it.
+	void set_shared_body_threshold(std::size_t threshold)
+	{
+		_shared_body_threshold = threshold;
+	}
+
+	// Successful GET responses with ETag or Last-Modified are remembered for up to this many resources and later
+	// requests of the same resource are sent as conditional, 304 from the server is then answered by the remembered
+	// response. Zero disables it. Requests which already carry their own conditions are passed as they are.
+	void set_validator_cache_size(std::size_t size)
+	{
+		_validator_cache_size = size;
+		if (_validator_cache_size == 0)
+			_validator_cache.clear();
+	}
 
 	template <typename Method, typename Resource>
 	HttpResponse send_request(Method&& method, Resource&& resource)
@@ -60,11 +94,100 @@ public:
 			std::forward<Headers>(headers),
 			std::forward<Content>(content)
 		};
+		return send_request(std::move(request));
+	}
+
+	// File descriptors added to the request are passed to the server and the ones sent by the server are added to the response.
+	// When compiled with ULOCAL_COMPRESSION, compressed responses are accepted and decompressed before they are returned.
+	HttpResponse send_request(HttpRequest request)
+	{
+		if (_validator_cache_size == 0
+			|| !icase_equal(request.get_method(), "GET")
+			|| !request.get_fds().empty()
+			|| request.has_header(HttpHeaderId::IfNoneMatch)
+			|| request.has_header(HttpHeaderId::IfModifiedSince))
+			return perform_request(std::move(request));
+
+		std::ostringstream key;
+		key << request.get_resource() << request.get_arguments();
+		auto itr = _validator_cache.find(key.str());
+		if (itr != _validator_cache.end())
+		{
+			if (auto etag = itr->second.get_header(HttpHeaderId::ETag))
+				request.add_header(HttpHeaderId::IfNoneMatch, etag->get_value());
+			if (auto last_modified = itr->second.get_header(HttpHeaderId::LastModified))
+				request.add_header(HttpHeaderId::IfModifiedSince, last_modified->get_value());
+		}
+
+		auto response = perform_request(std::move(request));
+		if (response.get_status_code() == 304 && itr != _validator_cache.end())
+			return itr->second;
+
+		bool has_validator = response.has_header(HttpHeaderId::ETag) || response.has_header(HttpHeaderId::LastModified);
+		if (response.get_status_code() != 200 || !has_validator || !response.get_fds().empty())
+		{
+			if (itr != _validator_cache.end())
+				_validator_cache.erase(itr);
+		}
+		else if (itr != _validator_cache.end())
+			itr->second = response;
+		else
+		{
+			// Any entry can go, those which are still used come back with the next full response
+			if (_validator_cache.size() >= _validator_cache_size)
+				_validator_cache.erase(_validator_cache.begin());
+			_validator_cache.emplace(key.str(), response);
+		}
+
+		return response;
+	}
+
+private:
+	HttpResponse perform_request(HttpRequest request)
+	{
+		if (_loopback)
+		{
+			request.calculate_content_length();
+			auto response = _loopback->submit(std::move(request), _listener).get();
+			decompress_response(response);
+			return response;
+		}
+
+#ifdef ULOCAL_COMPRESSION
+		if (!request.has_header(HttpHeaderId::AcceptEncoding))
+			request.add_header(HttpHeaderId::AcceptEncoding, "gzip, deflate");
+#endif
+
+		if (_shared_body_threshold > 0)
+		{
+			request.add_header(AcceptSharedBodyHeader, 1);
+			if (request.get_content().length() >= _shared_body_threshold)
+				share_body(request);
+		}
 		request.calculate_content_length();
 
 		Socket<> socket;
 		socket.connect(_local_socket_path);
-		socket.write(request.dump());
+		try
+		{
+			auto data = request.dump();
+			auto written = socket.write(data, request.get_fds());
+			while (written < data.length())
+			{
+				pollfd write_pollfd = {socket.get_fd(), POLLOUT, 0};
+				if (::poll(&write_pollfd, 1, -1) == -1)
+					throw RequestError("Unable to send request to the server");
+
+				written += written == 0
+					? socket.write(data, request.get_fds())
+					: socket.write(std::string_view{data}.substr(written));
+			}
+		}
+		catch (const SocketError&)
+		{
+			// Server may reject the connection before reading the request, its response can still be read
+			;
+		}
 
 		HttpResponseParser response_parser;
 		std::optional<HttpResponse> maybe_response;
@@ -77,24 +200,56 @@ public:
 			if (result == -1)
 				throw RequestError("Unable to obtain response from the server");
 
-			if (pollfd.revents & POLLIN)
+			// Response can be larger than the socket stream so it has to be read until the end even after hangup
+			if (pollfd.revents & (POLLIN | POLLHUP))
 			{
-				socket.read();
+				still_poll = socket.read();
 				maybe_response = response_parser.parse(socket.get_stream());
 			}
-
-			if (pollfd.revents & POLLHUP)
+			else if (pollfd.revents & (POLLERR | POLLNVAL))
 				still_poll = false;
 		}
 
 		if (!maybe_response)
 			throw RequestError("Server closed connection unexpectedly");
 
+		auto fd_count = maybe_response->get_announced_fd_count();
+		if (fd_count > socket.get_received_fd_count())
+			throw RequestError("Server announced more file descriptors than it sent");
+		for (auto& fd : socket.take_received_fds(fd_count))
+			maybe_response->add_fd(std::move(fd));
+		unshare_body(maybe_response.value(), _shared_body_threshold > 0 ? get_max_content_length() : 0);
+		decompress_response(maybe_response.value());
+
 		return std::move(maybe_response).value();
 	}
 
-private:
+	std::size_t get_max_content_length() const
+	{
+		return _max_content_length > 0 ? _max_content_length : std::numeric_limits<std::size_t>::max();
+	}
+
+	void decompress_response([[maybe_unused]] HttpResponse& response) const
+	{
+#ifdef ULOCAL_COMPRESSION
+		try
+		{
+			decompress_content(response, get_max_content_length());
+		}
+		catch (const CompressionError&)
+		{
+			throw RequestError("Unable to decompress the response");
+		}
+#endif
+	}
+
 	std::string _local_socket_path;
+	LoopbackTransport* _loopback;
+	std::size_t _listener;
+	std::size_t _shared_body_threshold;
+	std::size_t _max_content_length;
+	std::size_t _validator_cache_size;
+	std::unordered_map<std::string, HttpResponse> _validator_cache;
 };
 
 } // namespace ulocal
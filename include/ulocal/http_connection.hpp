@@ -1,27 +1,150 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
 #include <ulocal/http_request_parser.hpp>
+#include <ulocal/shared_body.hpp>
 #include <ulocal/socket.hpp>
+#include <ulocal/timer_wheel.hpp>
 
 namespace ulocal {
 
+enum class ConnectionPhase
+{
+	Idle,
+	ReadingHeaders,
+	ReadingContent,
+	Writing
+};
+
 class HttpConnection
 {
 public:
-	HttpConnection(Socket<>&& socket) : _socket(std::move(socket)), _request_parser() {}
+	HttpConnection(Socket<>&& socket, std::uint64_t id = 0, const std::optional<PeerCredentials>& peer_credentials = std::nullopt, std::size_t listener = 0)
+		: _socket(std::move(socket)), _request_parser(), _id(id), _peer_credentials(peer_credentials), _listener(listener), _output(), _shared_output(), _output_fds(), _output_offset(0), _request_id(0), _keep_alive(false),
+		_phase(ConnectionPhase::ReadingHeaders), _timer(TimerWheel::InvalidTimer), _poll_events(POLLIN) {}
 	HttpConnection(const HttpConnection&) = delete;
 	HttpConnection(HttpConnection&&) noexcept = default;
 
 	HttpConnection& operator=(const HttpConnection&) = delete;
 	HttpConnection& operator=(HttpConnection&&) noexcept = default;
 
+	std::uint64_t get_id() const { return _id; }
+	// Index of the server listener which accepted the connection
+	std::size_t get_listener() const { return _listener; }
 	Socket<>& get_socket() { return _socket; }
 	const Socket<>& get_socket() const { return _socket; }
-	std::optional<HttpRequest> get_request() { return _request_parser.parse(_socket.get_stream()); }
+	const std::optional<PeerCredentials>& get_peer_credentials() const { return _peer_credentials; }
+	// Requests with shared body are only accepted up to max_shared_body bytes, zero rejects them
+	std::optional<HttpRequest> get_request(std::size_t max_shared_body = 0)
+	{
+		auto request = _request_parser.parse(_socket.get_stream());
+		if (request)
+		{
+			// Descriptors arrive with the first byte of the request so they are all received once the request is complete
+			auto fd_count = request->get_announced_fd_count();
+			if (fd_count > _socket.get_received_fd_count())
+				throw ParseError("Request announced more file descriptors than it was sent");
+
+			for (auto& fd : _socket.take_received_fds(fd_count))
+				request->add_fd(std::move(fd));
+			unshare_body(request.value(), max_shared_body);
+		}
+		return request;
+	}
+
+	ConnectionPhase get_phase() const { return _phase; }
+	void set_phase(ConnectionPhase phase) { _phase = phase; }
+
+	// Phase the connection is in while waiting for the rest of the request
+	ConnectionPhase get_read_phase() const
+	{
+		if (_request_parser.is_reading_content())
+			return ConnectionPhase::ReadingContent;
+		else if (_phase == ConnectionPhase::Idle && _request_parser.is_idle() && _socket.get_stream().get_size() == 0)
+			return ConnectionPhase::Idle;
+		return ConnectionPhase::ReadingHeaders;
+	}
+
+	// Connection is neither in the middle of receiving a request nor sending a response
+	bool is_idle() const
+	{
+		return !has_pending_output() && _request_parser.is_idle() && _socket.get_stream().get_size() == 0;
+	}
+
+	TimerWheel::TimerId get_timer() const { return _timer; }
+	void set_timer(TimerWheel::TimerId timer) { _timer = timer; }
+
+	short get_poll_events() const { return _poll_events; }
+	void set_poll_events(short events) { _poll_events = events; }
+
+	std::uint64_t get_request_id() const { return _request_id; }
+	bool is_keep_alive() const { return _keep_alive; }
+	bool has_pending_output() const { return _output_offset < get_output().length(); }
+
+	void send(std::string&& data, std::uint64_t request_id, bool keep_alive, std::vector<FileDescriptor>&& fds = {})
+	{
+		_output = std::move(data);
+		_shared_output.reset();
+		_output_fds = std::move(fds);
+		_output_offset = 0;
+		_request_id = request_id;
+		_keep_alive = keep_alive;
+	}
+
+	// Sends response serialized once for multiple connections, the data are only referenced and never copied
+	void send(std::shared_ptr<const std::string> data, std::uint64_t request_id, bool keep_alive)
+	{
+		_output.clear();
+		_shared_output = std::move(data);
+		_output_fds.clear();
+		_output_offset = 0;
+		_request_id = request_id;
+		_keep_alive = keep_alive;
+	}
+
+	// Writes as much of the pending output as the socket accepts without blocking
+	std::size_t flush()
+	{
+		auto written = _socket.write(get_output().substr(_output_offset), _output_fds);
+		_output_offset += written;
+		if (written > 0)
+			_output_fds.clear();
+		if (!has_pending_output())
+		{
+			_output.clear();
+			_shared_output.reset();
+			_output_offset = 0;
+		}
+		return written;
+	}
 
 private:
+	std::string_view get_output() const
+	{
+		return _shared_output ? std::string_view{*_shared_output} : std::string_view{_output};
+	}
+
 	Socket<> _socket;
 	HttpRequestParser _request_parser;
+	std::uint64_t _id;
+	std::optional<PeerCredentials> _peer_credentials;
+	std::size_t _listener;
+
+	std::string _output;
+	std::shared_ptr<const std::string> _shared_output;
+	std::vector<FileDescriptor> _output_fds;
+	std::size_t _output_offset;
+	std::uint64_t _request_id;
+	bool _keep_alive;
+
+	ConnectionPhase _phase;
+	TimerWheel::TimerId _timer;
+	short _poll_events;
 };
 
 } // namespace ulocal
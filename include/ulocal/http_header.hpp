@@ -1,9 +1,72 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <string_view>
+
 #include <ulocal/key_value.hpp>
+#include <ulocal/utils.hpp>
 
 namespace ulocal {
 
 using HttpHeader = KeyValue;
 
+enum class HttpHeaderId : std::uint8_t
+{
+	Accept,
+	AcceptEncoding,
+	Connection,
+	ContentEncoding,
+	ContentLength,
+	ContentType,
+	ETag,
+	Host,
+	IfModifiedSince,
+	IfNoneMatch,
+	LastModified,
+	Server,
+	TransferEncoding,
+	UserAgent,
+	Vary,
+	Unknown
+};
+
+namespace detail {
+
+constexpr std::array<std::string_view, static_cast<std::size_t>(HttpHeaderId::Unknown)> known_header_names = {
+	"Accept",
+	"Accept-Encoding",
+	"Connection",
+	"Content-Encoding",
+	"Content-Length",
+	"Content-Type",
+	"ETag",
+	"Host",
+	"If-Modified-Since",
+	"If-None-Match",
+	"Last-Modified",
+	"Server",
+	"Transfer-Encoding",
+	"User-Agent",
+	"Vary"
+};
+
+} // namespace detail
+
+constexpr std::string_view get_header_name(HttpHeaderId id)
+{
+	return id == HttpHeaderId::Unknown ? std::string_view{} : detail::known_header_names[static_cast<std::size_t>(id)];
+}
+
+inline HttpHeaderId get_header_id(std::string_view name)
+{
+	for (std::size_t i = 0; i < detail::known_header_names.size(); ++i)
+	{
+		if (icase_equal(detail::known_header_names[i], name))
+			return static_cast<HttpHeaderId>(i);
+	}
+
+	return HttpHeaderId::Unknown;
+}
+
 } // namespace ulocal
@@ -1,16 +1,23 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
-#include <unordered_map>
+#include <string_view>
 
 #include <ulocal/http_header.hpp>
+#include <ulocal/small_vector.hpp>
 
 namespace ulocal {
 
 class HttpHeaderTable
 {
 public:
-	HttpHeaderTable() : _headers(), _table() {}
+	static constexpr std::size_t InlineCapacity = 16;
+
+	HttpHeaderTable() : _headers(), _known()
+	{
+		_known.fill(NoIndex);
+	}
 
 	auto begin() const { return _headers.begin(); }
 	auto end() const { return _headers.end(); }
@@ -19,47 +26,100 @@ public:
 	void clear()
 	{
 		_headers.clear();
-		_table.clear();
+		_known.fill(NoIndex);
 	}
 
-	bool has_header(const std::string& name) const
+	bool has_header(HttpHeaderId id) const
 	{
-		return _table.find(name) != _table.end();
+		return get_header(id) != nullptr;
 	}
 
-	HttpHeader* get_header(const std::string& name)
+	bool has_header(std::string_view name) const
 	{
-		auto itr = _table.find(name);
-		if (itr == _table.end())
-			return nullptr;
+		return get_header(name) != nullptr;
+	}
 
-		return &itr->second;
+	HttpHeader* get_header(HttpHeaderId id)
+	{
+		return const_cast<HttpHeader*>(std::as_const(*this).get_header(id));
 	}
 
-	const HttpHeader* get_header(const std::string& name) const
+	const HttpHeader* get_header(HttpHeaderId id) const
 	{
-		auto itr = _table.find(name);
-		if (itr == _table.end())
+		if (id == HttpHeaderId::Unknown)
 			return nullptr;
 
-		return &itr->second;
+		auto index = _known[static_cast<std::size_t>(id)];
+		return index == NoIndex ? nullptr : &_headers[index];
+	}
+
+	HttpHeader* get_header(std::string_view name)
+	{
+		return const_cast<HttpHeader*>(std::as_const(*this).get_header(name));
+	}
+
+	const HttpHeader* get_header(std::string_view name) const
+	{
+		if (auto id = get_header_id(name); id != HttpHeaderId::Unknown)
+			return get_header(id);
+
+		for (const auto& header : _headers)
+		{
+			if (icase_equal(header.get_name(), name))
+				return &header;
+		}
+
+		return nullptr;
+	}
+
+	template <typename T>
+	void add_header(HttpHeaderId id, T&& value)
+	{
+		if (id == HttpHeaderId::Unknown || has_header(id))
+			return;
+
+		_known[static_cast<std::size_t>(id)] = static_cast<std::uint32_t>(_headers.size());
+		_headers.emplace_back(std::string{get_header_name(id)}, std::forward<T>(value));
 	}
 
 	template <typename T1, typename T2>
 	void add_header(T1&& name, T2&& value)
 	{
-		auto itr = _table.find(name);
-		if (itr == _table.end())
+		auto id = get_header_id(name);
+		if (id == HttpHeaderId::Unknown)
+		{
+			if (!has_header(name))
+				_headers.emplace_back(std::forward<T1>(name), std::forward<T2>(value));
+		}
+		else if (!has_header(id))
+		{
+			_known[static_cast<std::size_t>(id)] = static_cast<std::uint32_t>(_headers.size());
+			_headers.emplace_back(std::forward<T1>(name), std::forward<T2>(value));
+		}
+	}
+
+	void remove_header(std::string_view name)
+	{
+		auto header = get_header(name);
+		if (!header)
+			return;
+
+		auto index = static_cast<std::uint32_t>(header - _headers.begin());
+		_headers.erase(_headers.begin() + index);
+		for (auto& known : _known)
 		{
-			auto header = HttpHeader{std::forward<T1>(name), std::forward<T2>(value)};
-			std::tie(itr, std::ignore) = _table.emplace(header.get_name(), std::move(header));
-			_headers.push_back(&itr->second);
+			if (known == index)
+				known = NoIndex;
+			else if (known != NoIndex && known > index)
+				--known;
 		}
 	}
 
 private:
-	std::vector<const HttpHeader*> _headers;
-	std::unordered_map<std::string, HttpHeader, CaseInsensitiveHash, CaseInsensitiveCompare> _table;
+	static constexpr std::uint32_t NoIndex = ~std::uint32_t{0};
+
+	SmallVector<HttpHeader, InlineCapacity> _headers;
+	std::array<std::uint32_t, static_cast<std::size_t>(HttpHeaderId::Unknown)> _known;
 };
 
 } // namespace ulocal
@@ -1,18 +1,38 @@
 #pragma once
 
+#include <exception>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <ulocal/file_descriptor.hpp>
 #include <ulocal/http_header_table.hpp>
 
 namespace ulocal {
 
+class ParseError : public std::exception
+{
+public:
+	ParseError(const char* msg) noexcept : _msg(msg) {}
+
+	virtual const char* what() const noexcept { return _msg; }
+
+private:
+	const char* _msg;
+};
+
+constexpr std::string_view FileDescriptorsHeader = "X-File-Descriptors";
+
 class HttpMessage
 {
 public:
-	HttpMessage() : _content() {}
-	HttpMessage(const std::string&& content) : _content(content), _headers() {}
-	HttpMessage(std::string&& content) : _content(std::move(content)), _headers() {}
+	HttpMessage() : _content(), _headers(), _fds() {}
+	HttpMessage(const std::string&& content) : _content(content), _headers(), _fds() {}
+	HttpMessage(std::string&& content) : _content(std::move(content)), _headers(), _fds() {}
 
 	template <typename Content, typename Headers>
-	HttpMessage(Content&& content, Headers&& headers) : _content(std::forward<Content>(content)), _headers(std::forward<Headers>(headers)) {}
+	HttpMessage(Content&& content, Headers&& headers) : _content(std::forward<Content>(content)), _headers(std::forward<Headers>(headers)), _fds() {}
 
 	HttpMessage(const HttpMessage&) = default;
 	HttpMessage(HttpMessage&&) noexcept = default;
@@ -22,10 +42,13 @@ public:
 	HttpMessage& operator=(HttpMessage&&) noexcept = default;
 
 	const std::string& get_content() const { return _content; }
+	void set_content(std::string content) { _content = std::move(content); }
 	const HttpHeaderTable& get_headers() const { return _headers; }
-	const HttpHeader* get_header(const std::string& name) const { return _headers.get_header(name); }
+	const HttpHeader* get_header(HttpHeaderId id) const { return _headers.get_header(id); }
+	const HttpHeader* get_header(std::string_view name) const { return _headers.get_header(name); }
 
-	bool has_header(const std::string& name) const { return _headers.has_header(name); }
+	bool has_header(HttpHeaderId id) const { return _headers.has_header(id); }
+	bool has_header(std::string_view name) const { return _headers.has_header(name); }
 
 	template <typename Name, typename Value>
 	void add_header(Name&& name, Value&& value)
@@ -33,17 +56,80 @@ public:
 		_headers.add_header(std::forward<Name>(name), std::forward<Value>(value));
 	}
 
+	void remove_header(std::string_view name)
+	{
+		_headers.remove_header(name);
+	}
+
+	// File descriptors travel next to the message (SCM_RIGHTS) and the message announces their number
+	// in X-File-Descriptors header. Copying the message duplicates them.
+	const std::vector<FileDescriptor>& get_fds() const { return _fds; }
+
+	void add_fd(FileDescriptor fd)
+	{
+		_fds.push_back(std::move(fd));
+	}
+
+	std::vector<FileDescriptor> release_fds()
+	{
+		return std::exchange(_fds, {});
+	}
+
+	// Number of file descriptors which the sender announced to send together with the message
+	std::size_t get_announced_fd_count() const
+	{
+		auto header = _headers.get_header(FileDescriptorsHeader);
+		if (!header)
+			return 0;
+
+		auto count = header->try_get_value_as<std::size_t>();
+		if (!count)
+			throw ParseError("Invalid number of file descriptors");
+		return count.value();
+	}
+
 	void calculate_content_length()
 	{
-		if (auto content_length = _headers.get_header("Content-Length"); !content_length && !_content.empty())
-			_headers.add_header("Content-Length", _content.length());
+		if (!_headers.has_header(HttpHeaderId::ContentLength) && !_content.empty())
+			_headers.add_header(HttpHeaderId::ContentLength, _content.length());
 	}
 
 	virtual std::string dump() const = 0;
 
 protected:
+	std::size_t get_dump_size() const
+	{
+		std::size_t result = 2 + _content.length();
+		for (const auto& header : _headers)
+			result += header.get_name().length() + header.get_value().length() + 4;
+		if (!_fds.empty())
+			result += FileDescriptorsHeader.length() + 8;
+		return result;
+	}
+
+	void dump_headers_and_content(std::string& out) const
+	{
+		for (const auto& header : _headers)
+		{
+			out.append(header.get_name());
+			out.append(": ");
+			out.append(header.get_value());
+			out.append("\r\n");
+		}
+		if (!_fds.empty() && !_headers.has_header(FileDescriptorsHeader))
+		{
+			out.append(FileDescriptorsHeader);
+			out.append(": ");
+			append_number(out, _fds.size());
+			out.append("\r\n");
+		}
+		out.append("\r\n");
+		out.append(_content);
+	}
+
 	std::string _content;
 	HttpHeaderTable _headers;
+	std::vector<FileDescriptor> _fds;
 };
 
 } // namespace ulocal
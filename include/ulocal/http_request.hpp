@@ -1,9 +1,11 @@
 #pragma once
 
 #include <sstream>
+#include <optional>
 #include <string>
 
 #include <ulocal/http_message.hpp>
+#include <ulocal/peer_credentials.hpp>
 #include <ulocal/url_args.hpp>
 
 namespace ulocal {
@@ -34,6 +36,7 @@ public:
 		, _method(std::forward<Method>(method))
 		, _resource(std::forward<Resource>(resource))
 		, _args(std::forward<Args>(args))
+		, _peer_credentials()
 	{
 	}
 
@@ -46,27 +49,31 @@ public:
 
 	const std::string& get_method() const { return _method; }
 	const std::string& get_resource() const { return _resource; }
-	const UrlArg* get_argument(const std::string& name) const { return _args.get_arg(name); }
+	const UrlArg* get_argument(std::string_view name) const { return _args.get_arg(name); }
 	const UrlArgs& get_arguments() const { return _args; }
 
-	bool has_arg(const std::string& name) const { return _args.has_arg(name); }
+	bool has_arg(std::string_view name) const { return _args.has_arg(name); }
+
+	// Credentials of the client which sent the request, only set on requests received by HttpServer
+	const std::optional<PeerCredentials>& get_peer_credentials() const { return _peer_credentials; }
+	void set_peer_credentials(const std::optional<PeerCredentials>& peer_credentials) { _peer_credentials = peer_credentials; }
 
 	virtual std::string dump() const override
 	{
 		std::ostringstream ss;
 		ss << _method << ' ' << _resource << _args << " HTTP/1.1\r\n";
-		for (const auto* header : _headers)
-			ss << header->get_name() << ": " << header->get_value() << "\r\n";
-		ss << "\r\n";
-		if (!_content.empty())
-			ss << _content;
-		return ss.str();
+
+		auto result = ss.str();
+		result.reserve(result.length() + get_dump_size());
+		dump_headers_and_content(result);
+		return result;
 	}
 
 private:
 	std::string _method;
 	std::string _resource;
 	UrlArgs _args;
+	std::optional<PeerCredentials> _peer_credentials;
 };
 
 } // namespace ulocal
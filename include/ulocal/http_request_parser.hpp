@@ -27,13 +27,21 @@ enum class RequestState
 class HttpRequestParser
 {
 public:
-	HttpRequestParser() : _state(detail::RequestState::Start) {}
+	HttpRequestParser() : _state(detail::RequestState::Start), _content_length(0) {}
 	HttpRequestParser(const HttpRequestParser&) = delete;
 	HttpRequestParser(HttpRequestParser&&) noexcept = default;
 
 	HttpRequestParser& operator=(const HttpRequestParser&) = delete;
 	HttpRequestParser& operator=(HttpRequestParser&&) noexcept = default;
 
+	// No part of the next request has been parsed yet
+	bool is_idle() const
+	{
+		return _state == detail::RequestState::Start || (_state == detail::RequestState::StatusLineMethod && _method.empty());
+	}
+
+	bool is_reading_content() const { return _state == detail::RequestState::Content; }
+
 	std::optional<HttpRequest> parse(StringStream& stream)
 	{
 		bool continue_parsing = true;
@@ -100,9 +108,17 @@ public:
 						stream.skip(2);
 						_state = detail::RequestState::Content;
 
-						auto content_length_header = _headers.get_header("content-length");
+						auto content_length_header = _headers.get_header(HttpHeaderId::ContentLength);
 						if (content_length_header)
-							_content_length = content_length_header->get_value_as<std::uint64_t>();
+						{
+							auto content_length = content_length_header->try_get_value_as<std::uint64_t>();
+							if (!content_length)
+							{
+								_state = detail::RequestState::Start;
+								throw ParseError("Invalid Content-Length header");
+							}
+							_content_length = content_length.value();
+						}
 					}
 					else if (stream.as_string_view(1) == "\r")
 					{
@@ -140,14 +156,19 @@ public:
 				}
 				case detail::RequestState::Content:
 				{
-					auto str = stream.read(_content_length - _content.length());
-					_content += str;
+					// Reading 0 bytes from the stream would read everything, including the next message
+					if (auto remaining = _content_length - _content.length(); remaining > 0)
+						_content += stream.read(remaining);
 					if (_content.length() == _content_length)
 					{
 						_state = detail::RequestState::Start;
+						// Make room for the next message on the same connection
+						stream.realign();
+						auto [resource, args] = UrlArgs::parse_from_received_resource(_resource);
 						return HttpRequest{
 							std::move(_method),
-							std::move(_resource),
+							std::move(resource),
+							std::move(args),
 							std::move(_headers),
 							std::move(_content)
 						};
@@ -1,12 +1,86 @@
 #pragma once
 
-#include <sstream>
+#include <array>
+#include <optional>
 #include <string>
+#include <string_view>
 
 #include <ulocal/http_message.hpp>
 
 namespace ulocal {
 
+namespace detail {
+
+constexpr std::string_view status_lines[] = {
+	"HTTP/1.1 100 Continue\r\n",
+	"HTTP/1.1 101 Switching Protocols\r\n",
+	"HTTP/1.1 200 OK\r\n",
+	"HTTP/1.1 201 Created\r\n",
+	"HTTP/1.1 202 Accepted\r\n",
+	"HTTP/1.1 203 Non-Authoritative Information\r\n",
+	"HTTP/1.1 204 No Content\r\n",
+	"HTTP/1.1 205 Reset Content\r\n",
+	"HTTP/1.1 206 Partial Content\r\n",
+	"HTTP/1.1 300 Multiple Choices\r\n",
+	"HTTP/1.1 301 Moved Permanently\r\n",
+	"HTTP/1.1 302 Found\r\n",
+	"HTTP/1.1 303 See Other\r\n",
+	"HTTP/1.1 304 Not Modified\r\n",
+	"HTTP/1.1 305 Use Proxy\r\n",
+	"HTTP/1.1 307 Temporary Redirect\r\n",
+	"HTTP/1.1 400 Bad Request\r\n",
+	"HTTP/1.1 401 Unauthorized\r\n",
+	"HTTP/1.1 402 Payment Required\r\n",
+	"HTTP/1.1 403 Forbidden\r\n",
+	"HTTP/1.1 404 Not Found\r\n",
+	"HTTP/1.1 405 Method Not Allowed\r\n",
+	"HTTP/1.1 406 Not Acceptable\r\n",
+	"HTTP/1.1 407 Proxy Authentication Required\r\n",
+	"HTTP/1.1 408 Request Timeout\r\n",
+	"HTTP/1.1 409 Conflict\r\n",
+	"HTTP/1.1 410 Gone\r\n",
+	"HTTP/1.1 411 Length Required\r\n",
+	"HTTP/1.1 412 Precondition Failed\r\n",
+	"HTTP/1.1 413 Request Entity Too Large\r\n",
+	"HTTP/1.1 414 Request-URI Too Long\r\n",
+	"HTTP/1.1 415 Unsupported Media Type\r\n",
+	"HTTP/1.1 416 Requested Range Not Satisfiable\r\n",
+	"HTTP/1.1 417 Expectation Failed\r\n",
+	"HTTP/1.1 500 Internal Server Error\r\n",
+	"HTTP/1.1 501 Not Implemented\r\n",
+	"HTTP/1.1 502 Bad Gateway\r\n",
+	"HTTP/1.1 503 Service Unavailable\r\n",
+	"HTTP/1.1 504 Gateway Timeout\r\n",
+	"HTTP/1.1 505 HTTP Version Not Supported\r\n"
+};
+
+constexpr int MaxStatusCode = 599;
+
+constexpr auto status_line_table = [] {
+	std::array<std::string_view, MaxStatusCode + 1> result = {};
+	for (auto line : status_lines)
+		result[(line[9] - '0') * 100 + (line[10] - '0') * 10 + (line[11] - '0')] = line;
+	return result;
+}();
+
+} // namespace detail
+
+constexpr std::string_view get_status_line(int status_code)
+{
+	if (status_code < 0 || status_code > detail::MaxStatusCode)
+		return {};
+	return detail::status_line_table[status_code];
+}
+
+constexpr std::string_view get_reason_phrase(int status_code)
+{
+	auto status_line = get_status_line(status_code);
+	if (status_line.empty())
+		return "Unknown";
+	// Strip "HTTP/1.1 XXX " and trailing "\r\n"
+	return status_line.substr(13, status_line.length() - 15);
+}
+
 class HttpResponse : public HttpMessage
 {
 public:
@@ -37,71 +111,36 @@ public:
 
 	std::string get_reason() const
 	{
-		static const std::unordered_map<int, std::string_view> status_code_names = {
-			{ 100, "Continue" },
-			{ 101, "Switching Protocols" },
-			{ 200, "OK" },
-			{ 201, "Created" },
-			{ 202, "Accepted" },
-			{ 203, "Non-Authoritative Information" },
-			{ 204, "No Content" },
-			{ 205, "Reset Content" },
-			{ 206, "Partial Content" },
-			{ 300, "Multiple Choices" },
-			{ 301, "Moved Permanently" },
-			{ 302, "Found" },
-			{ 303, "See Other" },
-			{ 304, "Not Modified" },
-			{ 305, "Use Proxy" },
-			{ 307, "Temporary Redirect" },
-			{ 400, "Bad Request" },
-			{ 401, "Unauthorized" },
-			{ 402, "Payment Required" },
-			{ 403, "Forbidden" },
-			{ 404, "Not Found" },
-			{ 405, "Method Not Allowed" },
-			{ 406, "Not Acceptable" },
-			{ 407, "Proxy Authentication Required" },
-			{ 408, "Request Timeout" },
-			{ 409, "Conflict" },
-			{ 410, "Gone" },
-			{ 411, "Length Required" },
-			{ 412, "Precondition Failed" },
-			{ 413, "Request Entity Too Large" },
-			{ 414, "Request-URI Too Long" },
-			{ 415, "Unsupported Media Type" },
-			{ 416, "Requested Range Not Satisfiable" },
-			{ 417, "Expectation Failed" },
-			{ 500, "Internal Server Error" },
-			{ 501, "Not Implemented" },
-			{ 502, "Bad Gateway" },
-			{ 503, "Service Unavailable" },
-			{ 504, "Gateway Timeout" },
-			{ 505, "HTTP Version Not Supported" }
-		};
+		return std::string{get_reason_view()};
+	}
 
+	// Doesn't allocate, the view is valid as long as the response is alive and its reason isn't changed
+	std::string_view get_reason_view() const
+	{
 		if (_reason.has_value())
 			return _reason.value();
-		else
-		{
-			auto itr = status_code_names.find(_status_code);
-			if (itr != status_code_names.end())
-				return std::string{itr->second};
-		}
-
-		return "Unknown";
+		return get_reason_phrase(_status_code);
 	}
 
 	virtual std::string dump() const override
 	{
-		std::ostringstream ss;
-		ss << "HTTP/1.1 " << _status_code << " " << get_reason() << "\r\n";
-		for (const auto* header : _headers)
-			ss << header->get_name() << ": " << header->get_value() << "\r\n";
-		ss << "\r\n";
-		if (!_content.empty())
-			ss << _content;
-		return ss.str();
+		auto status_line = _reason.has_value() ? std::string_view{} : get_status_line(_status_code);
+
+		std::string result;
+		result.reserve((status_line.empty() ? 32 + get_reason_view().length() : status_line.length()) + get_dump_size());
+		if (!status_line.empty())
+			result.append(status_line);
+		else
+		{
+			result.append("HTTP/1.1 ");
+			append_number(result, _status_code);
+			result += ' ';
+			result.append(get_reason_view());
+			result.append("\r\n");
+		}
+
+		dump_headers_and_content(result);
+		return result;
 	}
 
 private:
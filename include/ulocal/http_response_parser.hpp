@@ -25,7 +25,7 @@ enum class ResponseState
 class HttpResponseParser
 {
 public:
-	HttpResponseParser() : _state(detail::ResponseState::Start) {}
+	HttpResponseParser() : _state(detail::ResponseState::Start), _status_code(0), _content_length(0) {}
 	HttpResponseParser(const HttpResponseParser&) = delete;
 	HttpResponseParser(HttpResponseParser&&) noexcept = default;
 
@@ -41,7 +41,8 @@ public:
 			{
 				case detail::ResponseState::Start:
 					_http_version.clear();
-					_status_code.clear();
+					_status_code_str.clear();
+					_status_code = 0;
 					_reason.clear();
 					_header_name.clear();
 					_header_value.clear();
@@ -66,9 +67,17 @@ public:
 				case detail::ResponseState::StatusLineCode:
 				{
 					auto [str, found_space] = stream.read_until(' ');
-					_status_code += str;
+					_status_code_str += str;
 					if (found_space)
 					{
+						auto status_code = detail::ValueGetter<int>::convert(_status_code_str);
+						if (!status_code)
+						{
+							_state = detail::ResponseState::Start;
+							throw ParseError("Invalid status code");
+						}
+
+						_status_code = status_code.value();
 						_state = detail::ResponseState::StatusLineReason;
 						stream.skip(1);
 					}
@@ -96,9 +105,17 @@ public:
 						stream.skip(2);
 						_state = detail::ResponseState::Content;
 
-						auto content_length_header = _headers.get_header("content-length");
+						auto content_length_header = _headers.get_header(HttpHeaderId::ContentLength);
 						if (content_length_header)
-							_content_length = content_length_header->get_value_as<std::uint64_t>();
+						{
+							auto content_length = content_length_header->try_get_value_as<std::uint64_t>();
+							if (!content_length)
+							{
+								_state = detail::ResponseState::Start;
+								throw ParseError("Invalid Content-Length header");
+							}
+							_content_length = content_length.value();
+						}
 					}
 					else if (stream.as_string_view(1) == "\r")
 					{
@@ -136,13 +153,16 @@ public:
 				}
 				case detail::ResponseState::Content:
 				{
-					auto str = stream.read(_content_length - _content.length());
-					_content += str;
+					// Reading 0 bytes from the stream would read everything, including the next message
+					if (auto remaining = _content_length - _content.length(); remaining > 0)
+						_content += stream.read(remaining);
 					if (_content.length() == _content_length)
 					{
 						_state = detail::ResponseState::Start;
+						// Make room for the next message on the same connection
+						stream.realign();
 						return HttpResponse{
-							std::stoi(_status_code),
+							_status_code,
 							std::move(_reason),
 							std::move(_headers),
 							std::move(_content)
@@ -161,8 +181,9 @@ public:
 
 private:
 	detail::ResponseState _state;
-	std::string _http_version, _status_code, _reason, _header_name, _header_value, _content;
+	std::string _http_version, _status_code_str, _reason, _header_name, _header_value, _content;
 	HttpHeaderTable _headers;
+	int _status_code;
 	std::uint64_t _content_length;
 };
 
@@ -1,157 +1,445 @@
 #pragma once
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <thread>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
 
-#include <poll.h>
-
+#include <ulocal/compression.hpp>
+#include <ulocal/conditional.hpp>
+#include <ulocal/event_fd.hpp>
 #include <ulocal/http_connection.hpp>
 #include <ulocal/http_request.hpp>
 #include <ulocal/http_response.hpp>
-#include <ulocal/pipe.hpp>
+#include <ulocal/loopback.hpp>
+#include <ulocal/mpsc_queue.hpp>
+#include <ulocal/poller.hpp>
+#include <ulocal/response_cache.hpp>
 #include <ulocal/route_table.hpp>
+#include <ulocal/server_metrics.hpp>
 #include <ulocal/socket.hpp>
+#include <ulocal/socket_activation.hpp>
+#include <ulocal/timer_wheel.hpp>
+#include <ulocal/tracing.hpp>
 #include <ulocal/version.hpp>
 
 namespace ulocal {
 
-class HttpServer
+// Zero disables the respective timeout
+struct HttpServerTimeouts
+{
+	// Time to receive the request line and all headers, measured from the first byte of the request
+	std::chrono::milliseconds header = std::chrono::seconds(10);
+	// Time to receive the request content once the headers are read
+	std::chrono::milliseconds content = std::chrono::seconds(30);
+	// Time a kept alive connection can wait for the next request
+	std::chrono::milliseconds idle = std::chrono::seconds(60);
+	// Time the client can go without reading any part of the response
+	std::chrono::milliseconds write = std::chrono::seconds(30);
+};
+
+// Zero disables the respective limit
+struct HttpServerLimits
+{
+	// Size of the queue of connections waiting to be accepted
+	int backlog = 128;
+	// New connections are left waiting in the backlog once there are this many open connections
+	std::size_t max_connections = 1000;
+	// New connections are answered with 503 right away and closed once there are this many open connections
+	std::size_t overload_connections = 0;
+	// Number of connections accepted at once so a burst of new connections doesn't starve the existing ones
+	std::size_t accepts_per_iteration = 64;
+	// Accepting is paused for this long when the process runs out of descriptors or memory
+	std::chrono::milliseconds accept_backoff = std::chrono::milliseconds(100);
+	// Requests with larger body passed in shared memory are answered with 400 before the body is read
+	std::size_t max_shared_body = 256 * 1024 * 1024;
+};
+
+// Only takes effect when compiled with ULOCAL_COMPRESSION, responses of other routes than those added by
+// HttpServer::compress_endpoint() are never compressed
+struct HttpServerCompression
+{
+	// Responses with less content than this are sent as they are since compressing them doesn't pay off
+	std::size_t min_size = 1024;
+	// zlib compression level from 1 (fastest) to 9 (smallest), -1 picks the zlib default
+	int level = -1;
+};
+
+// Connections of peers whose user or group is not listed are answered with 403 and closed right after they are
+// accepted, before anything is read from them. Both lists empty allow everyone.
+struct PeerFilter
+{
+	std::vector<uid_t> uids;
+	std::vector<gid_t> gids;
+
+	bool is_enabled() const
+	{
+		return !uids.empty() || !gids.empty();
+	}
+
+	bool allows(const std::optional<PeerCredentials>& credentials) const
+	{
+		if (!is_enabled())
+			return true;
+		else if (!credentials)
+			return false;
+
+		return std::find(uids.begin(), uids.end(), credentials->uid) != uids.end()
+			|| std::find(gids.begin(), gids.end(), credentials->gid) != gids.end();
+	}
+};
+
+struct DrainProgress
+{
+	// Connections which are still open
+	std::size_t open_connections = 0;
+	// Open connections which are in the middle of receiving a request or sending a response
+	std::size_t busy_connections = 0;
+	// Connections closed since the draining started, either because they were idle or done with their last request
+	std::size_t closed_connections = 0;
+	// Connections which were still open when the deadline passed and had to be closed forcibly
+	std::size_t forced_connections = 0;
+	std::chrono::milliseconds elapsed = std::chrono::milliseconds(0);
+	bool done = false;
+};
+
+class HttpServer : public LoopbackTransport
 {
 public:
 	using RequestCallback = std::function<HttpResponse(const HttpRequest&)>;
+	using ListenerId = std::size_t;
+
+	// Listener of the local socket path passed to the constructor
+	static constexpr ListenerId DefaultListener = 0;
 
 	HttpServer(const std::string& local_socket_path)
-		: _routes(), _local_socket_path(local_socket_path), _server(), _clients(), _thread(), _control_pipe(), _server_header() {}
+		: _listeners(), _clients(), _thread(), _wakeup(), _commands(), _running(false), _loopback_mutex(), _loopback_open(false), _draining(false),
+		_drain_start(), _drain_initial_connections(0), _drain_progress(), _drain_progress_callback(), _drain_timer(TimerWheel::InvalidTimer), _server_header(), _metrics(), _trace_sink(nullptr), _last_connection_id(0), _last_request_id(0),
+		_timers(), _timeouts(), _keep_alive(false), _limits(), _overload_response(), _forbidden_response(), _shared_body_threshold(0),
+		_compression(), _flights(), _response_cache(),
+		_poller_backend(PollerBackend::Auto), _poller(), _accepting(false), _accept_backoff_timer(TimerWheel::InvalidTimer)
+	{
+		add_listener(local_socket_path);
+	}
+
 	HttpServer(const std::string& local_socket_path, const std::string& server_header) : HttpServer(local_socket_path)
 	{
 		_server_header = server_header;
 	}
 
+	// Adds another local socket served by the same thread, each listener has its own endpoints and peer filter.
+	// Has to be called before serve().
+	ListenerId add_listener(const std::string& local_socket_path)
+	{
+		_listeners.push_back(Listener{local_socket_path, Socket<>{}, RouteTable<RequestCallback>{}, PeerFilter{}, {}, {}, {}});
+		return _listeners.size() - 1;
+	}
+
+	ListenerId add_listener(Socket<>&& listening_socket)
+	{
+		auto listener = add_listener(std::string{});
+		set_listening_socket(listener, std::move(listening_socket));
+		return listener;
+	}
+
+	// Endpoints added while the server is running are added on the thread which serves requests
 	template <typename Fn>
 	void endpoint(const std::initializer_list<std::string>& methods, const std::string& route, const Fn& fn)
 	{
-		_routes.add_route(route, methods, fn);
+		endpoint(DefaultListener, methods, route, fn);
+	}
+
+	template <typename Fn>
+	void endpoint(ListenerId listener, const std::initializer_list<std::string>& methods, const std::string& route, const Fn& fn)
+	{
+		check_listener(listener);
+		if (_thread.joinable())
+			post_command(AddRouteCommand{listener, route, methods, fn});
+		else
+			add_route(listener, route, methods, fn);
+	}
+
+	// Validator is called first and the client which already has the representation it describes gets 304 without
+	// the handler being called at all, so expensive responses are only built when they are going to be sent.
+	// Successful responses of the handler get ETag and Last-Modified headers from the validator.
+	template <typename Validator, typename Fn>
+	void conditional_endpoint(const std::initializer_list<std::string>& methods, const std::string& route, const Validator& validator, const Fn& fn)
+	{
+		conditional_endpoint(DefaultListener, methods, route, validator, fn);
+	}
+
+	template <typename Validator, typename Fn>
+	void conditional_endpoint(ListenerId listener, const std::initializer_list<std::string>& methods, const std::string& route, const Validator& validator, const Fn& fn)
+	{
+		endpoint(listener, methods, route, [validator, fn](const HttpRequest& request) -> HttpResponse {
+			ResponseValidator current = validator(request);
+			if (is_not_modified(request, current))
+			{
+				HttpResponse response{304};
+				current.apply(response);
+				return response;
+			}
+
+			HttpResponse response = fn(request);
+			if (response.get_status_code() >= 200 && response.get_status_code() < 300)
+				current.apply(response);
+			return response;
+		});
+	}
+
+	void metrics_endpoint(const std::string& route = "/metrics")
+	{
+		metrics_endpoint(DefaultListener, route);
+	}
+
+	void metrics_endpoint(ListenerId listener, const std::string& route = "/metrics")
+	{
+		endpoint(listener, {"GET"}, route, [this](const HttpRequest&) -> HttpResponse {
+			HttpResponse response{200, get_metrics().to_prometheus()};
+			response.add_header(HttpHeaderId::ContentType, "text/plain; version=0.0.4");
+			return response;
+		});
+	}
+
+	// Responses of the route are compressed with gzip or deflate if the client accepts it in Accept-Encoding
+	void compress_endpoint(const std::string& route)
+	{
+		compress_endpoint(DefaultListener, route);
+	}
+
+	void compress_endpoint(ListenerId listener, const std::string& route)
+	{
+		check_listener(listener);
+		if (_thread.joinable())
+			post_command(RunCommand{[this, listener, route]() { _listeners[listener].compressed_routes.insert(route); }});
+		else
+			_listeners[listener].compressed_routes.insert(route);
+	}
+
+	// Identical GET and HEAD requests of the route which arrive in the same iteration of the event loop share one call
+	// of the handler and its response is serialized once for all of them. Requests are identical when they have the same
+	// resource, arguments in any order and values of the key headers. Handler must not depend on anything else,
+	// e.g. the peer credentials.
+	void coalesce_endpoint(const std::string& route, const std::vector<std::string>& key_headers = {})
+	{
+		coalesce_endpoint(DefaultListener, route, key_headers);
+	}
+
+	void coalesce_endpoint(ListenerId listener, const std::string& route, const std::vector<std::string>& key_headers = {})
+	{
+		check_listener(listener);
+		if (_thread.joinable())
+			post_command(RunCommand{[this, listener, route, key_headers]() { _listeners[listener].coalesced_routes[route] = key_headers; }});
+		else
+			_listeners[listener].coalesced_routes[route] = key_headers;
+	}
+
+	// Responses of the route are kept in the response cache set by set_response_cache() for the given time and identical
+	// GET and HEAD requests are answered from the cache without calling the handler. Requests are identical when they
+	// have the same resource, arguments in any order and values of the key headers. Only 200 responses without file
+	// descriptors are cached.
+	void cache_endpoint(const std::string& route, std::chrono::milliseconds ttl, const std::vector<std::string>& key_headers = {})
+	{
+		cache_endpoint(DefaultListener, route, ttl, key_headers);
+	}
+
+	void cache_endpoint(ListenerId listener, const std::string& route, std::chrono::milliseconds ttl, const std::vector<std::string>& key_headers = {})
+	{
+		check_listener(listener);
+		if (_thread.joinable())
+			post_command(RunCommand{[this, listener, route, ttl, key_headers]() { _listeners[listener].cached_routes[route] = CachedRoute{ttl, key_headers}; }});
+		else
+			_listeners[listener].cached_routes[route] = CachedRoute{ttl, key_headers};
+	}
+
+	// Removes cached responses of all resources starting with the prefix, can be called from any thread.
+	// Returns number of removed responses.
+	std::size_t invalidate_cache(std::string_view resource_prefix)
+	{
+		return _response_cache ? _response_cache->invalidate(resource_prefix) : 0;
+	}
+
+	MetricsSnapshot get_metrics() const
+	{
+		return _metrics.snapshot();
+	}
+
+	// Tracing hooks are only compiled in when ULOCAL_TRACING is defined, the sink has to outlive the server
+	void set_trace_sink(TraceSink* trace_sink)
+	{
+		_trace_sink = trace_sink;
+	}
+
+	// Connections are kept open for another request only if the client asks for it with Connection: keep-alive
+	void set_keep_alive(bool keep_alive)
+	{
+		_keep_alive = keep_alive;
+	}
+
+	void set_timeouts(const HttpServerTimeouts& timeouts)
+	{
+		_timeouts = timeouts;
+	}
+
+	// Has to be called before serve(), PollerBackend::Auto picks the best backend available on the running kernel
+	void set_poller_backend(PollerBackend backend)
+	{
+		_poller_backend = backend;
+	}
+
+	PollerBackend get_poller_backend() const
+	{
+		return _poller ? _poller->get_backend() : _poller_backend;
+	}
+
+	void set_limits(const HttpServerLimits& limits)
+	{
+		_limits = limits;
+	}
+
+	// Serves on socket which is already bound and listening instead of binding the local socket path, e.g. socket
+	// passed by the service manager or received from the process which is being replaced. Has to be called before serve().
+	void set_listening_socket(Socket<>&& listening_socket)
+	{
+		set_listening_socket(DefaultListener, std::move(listening_socket));
+	}
+
+	void set_listening_socket(ListenerId listener, Socket<>&& listening_socket)
+	{
+		check_listener(listener);
+		if (!listening_socket.is_listening())
+			throw SocketError("Socket is not listening");
+		_listeners[listener].socket = std::move(listening_socket);
+	}
+
+	// Listening socket to hand over to the process which replaces this one. Once it's sent, the server should be drained
+	// so both processes don't accept connections from the shared listen queue for longer than necessary.
+	const Socket<>& get_listening_socket(ListenerId listener = DefaultListener) const
+	{
+		check_listener(listener);
+		return _listeners[listener].socket;
+	}
+
+	// Response bodies of at least this size are passed in shared memory to clients which announce they accept it and
+	// requests with shared bodies are accepted up to HttpServerLimits::max_shared_body, zero disables both.
+	void set_shared_body_threshold(std::size_t threshold)
+	{
+		_shared_body_threshold = threshold;
+	}
+
+	// Has to be called before serve(), zero disables the cache. Memory budget is split evenly between the shards
+	// and responses which don't fit into the part of a single shard are never cached.
+	void set_response_cache(std::size_t memory_budget, std::size_t shards = 8)
+	{
+		_response_cache = memory_budget > 0 ? std::make_unique<ResponseCache>(memory_budget, shards) : nullptr;
+	}
+
+	void set_compression(const HttpServerCompression& compression)
+	{
+		_compression = compression;
+	}
+
+	// Has to be called before serve()
+	void set_peer_filter(const PeerFilter& peer_filter)
+	{
+		set_peer_filter(DefaultListener, peer_filter);
+	}
+
+	void set_peer_filter(ListenerId listener, const PeerFilter& peer_filter)
+	{
+		check_listener(listener);
+		_listeners[listener].peer_filter = peer_filter;
 	}
 
 	bool is_serving() const
 	{
-		return _server.is_listening();
+		return _listeners[DefaultListener].socket.is_listening();
 	}
 
 	void serve()
 	{
-		_server.listen(_local_socket_path);
+		for (auto& listener : _listeners)
+		{
+			if (!listener.socket.is_listening())
+				listener.socket.listen(listener.local_socket_path, _limits.backlog > 0 ? _limits.backlog : SOMAXCONN);
+		}
+		_overload_response = create_rejection_response(503);
+		_forbidden_response = create_rejection_response(403);
 
-		_thread = std::thread([this]() {
-			bool running = true;
-			while (running)
-			{
-				std::vector<pollfd> poll_fds;
-				poll_fds.reserve(_clients.size() + 1);
-				for (const auto& connection : _clients)
-					poll_fds.push_back(connection.get_socket().get_poll_fd());
-				poll_fds.push_back(_server.get_poll_fd());
-				poll_fds.push_back(_control_pipe.get_read_socket()->get_poll_fd());
-
-				auto* server_pollfd = &poll_fds[poll_fds.size() - 2];
-				auto* control_pipe_pollfd = &poll_fds[poll_fds.size() - 1];
-
-				auto result = ::poll(poll_fds.data(), poll_fds.size(), -1);
-				if (result == -1)
-					throw SocketError("Failed while polling HTTP connections");
-				else if (result == 0)
-					continue;
+		_poller = create_poller(_poller_backend);
+		for (ListenerId listener = 0; listener < _listeners.size(); ++listener)
+			_poller->add(_listeners[listener].socket.get_fd(), get_listener_token(listener), POLLIN);
+		_poller->add(_wakeup.get_fd(), ControlToken, POLLIN);
+		_accepting = true;
+		_running = true;
 
-				if (control_pipe_pollfd->revents & POLLIN)
+		// Loopback clients compare their thread with the serving one so it has to be assigned before they can submit
+		std::lock_guard<std::mutex> lock(_loopback_mutex);
+		_loopback_open = true;
+		_thread = std::thread([this]() {
+			std::vector<PollEvent> events;
+			while (_running)
+			{
+				if (!_draining && _accepting != can_accept())
 				{
-					_control_pipe.get_read_socket()->read();
-					auto command = _control_pipe.get_read_socket()->get_stream().read_until('\0');
-					if (command.first == "stop")
-						running = false;
+					_accepting = !_accepting;
+					for (ListenerId listener = 0; listener < _listeners.size(); ++listener)
+						_poller->modify(_listeners[listener].socket.get_fd(), get_listener_token(listener), _accepting ? POLLIN : 0);
 				}
 
-				if (server_pollfd->revents & POLLIN)
+				_poller->wait(events, get_poll_timeout());
+
+				for (const auto& event : events)
 				{
-					auto new_client = _server.accept_connection();
-					while (new_client)
+					if (event.token == ControlToken)
+						process_commands();
+					else if (event.token >= get_listener_token(_listeners.size() - 1))
 					{
-						_clients.push_back(std::move(new_client).value());
-						new_client = _server.accept_connection();
+						if (event.events & POLLIN)
+							accept_connections(ControlToken - 1 - event.token);
 					}
-				}
-
-				std::size_t index = 0;
-				for (auto& connection : _clients)
-				{
-					if (index >= poll_fds.size() - 2)
-						break;
-
-					auto& poll_fd = poll_fds[index];
-					if (poll_fd.revents & POLLIN)
+					else if (auto itr = _clients.find(event.token); itr != _clients.end())
 					{
-						std::optional<HttpResponse> response;
-
-						try
-						{
-							connection.get_socket().read();
-						}
-						catch (const std::exception& err)
-						{
-							response = HttpResponse{500};
-						}
-
-						auto maybe_request = connection.get_request();
-						if (maybe_request)
-						{
-							auto request = std::move(maybe_request).value();
-							if (!_routes.has_route(request.get_resource()))
-								response = HttpResponse{404};
-							else if (!_routes.has_route_for_method(request.get_resource(), request.get_method()))
-								response = HttpResponse{405};
-							else
-							{
-								try
-								{
-									response = _routes.perform_action(request.get_resource(), request.get_method(), request);
-								}
-								catch (const std::exception& err)
-								{
-									response = HttpResponse{500};
-								}
-							}
-						}
-
-						if (response)
-						{
-							response->calculate_content_length();
-							if (_server_header)
-								response->add_header("Server", _server_header.value());
-							response->add_header("Connection", "close");
-							response->add_header("X-Framework", "ulocal " ULOCAL_VERSION);
-
-							try
-							{
-								connection.get_socket().write(response->dump());
-							}
-							catch (const std::exception& err)
-							{
-								;
-							}
-							connection.get_socket().close();
-						}
+						handle_connection(itr->second, event.events);
+						update_poll_events(itr->second);
 					}
+				}
+
+				// Requests from the next iteration may already see a different state so they have to call the handlers again
+				_flights.clear();
 
-					if (poll_fd.revents & POLLHUP)
-						connection.get_socket().close();
+				expire_timers();
 
-					++index;
+				for (auto itr = _clients.begin(); itr != _clients.end();)
+				{
+					if (itr->second.get_socket().is_closed())
+						itr = _clients.erase(itr);
+					else
+						++itr;
 				}
 
-				auto remove_itr = std::remove_if(_clients.begin(), _clients.end(), [](const auto& connection) {
-					return connection.get_socket().is_closed();
-				});
-				_clients.erase(remove_itr, _clients.end());
+				if (_draining)
+					update_drain_progress();
+			}
+
+			// Loopback clients wait for their responses so they have to learn that nobody is going to send them.
+			// Nothing can be submitted once the loopback is closed so all remaining requests are in the queue now.
+			close_loopback();
+			while (auto command = _commands.pop())
+			{
+				if (auto loopback = std::get_if<LoopbackCommand>(&command.value()))
+					loopback->response.set_exception(std::make_exception_ptr(SocketError("Server closed connection unexpectedly")));
 			}
 		});
 	}
@@ -163,19 +451,915 @@ public:
 
 	void terminate()
 	{
-		_control_pipe.get_write_socket()->write("stop\0");
+		post_command(StopCommand{});
+	}
+
+	// Stops accepting new connections and closes the existing ones once they are done with the requests
+	// they already started to send, the server stops after all connections are closed
+	void drain()
+	{
+		post_command(DrainCommand{});
+	}
+
+	// Drains the server like drain() but closes the connections which are still open when the deadline passes.
+	// Blocks until the server stops, progress is reported from the serving thread whenever a connection closes.
+	DrainProgress shutdown(std::chrono::steady_clock::time_point deadline, std::function<void(const DrainProgress&)> progress = {})
+	{
+		if (!_thread.joinable())
+			return DrainProgress{0, 0, 0, 0, std::chrono::milliseconds(0), true};
+
+		post_command(DrainCommand{deadline, std::move(progress)});
+		wait_until_done();
+		return _drain_progress;
+	}
+
+	template <typename Rep, typename Period>
+	DrainProgress shutdown(std::chrono::duration<Rep, Period> timeout, std::function<void(const DrainProgress&)> progress = {})
+	{
+		return shutdown(std::chrono::steady_clock::now() + timeout, std::move(progress));
+	}
+
+	// Request from HttpClient in the same process which is handled like if it came through the listener socket
+	// except that it's neither serialized nor parsed and doesn't count as a connection
+	std::future<HttpResponse> submit(HttpRequest&& request, ListenerId listener = DefaultListener) override
+	{
+		check_listener(listener);
+
+		// Check and push have to be done under the same lock as closing, otherwise the request could be pushed
+		// after the serving thread has failed the remaining ones and nobody would ever respond to it
+		std::lock_guard<std::mutex> lock(_loopback_mutex);
+		if (!_loopback_open)
+			throw SocketError("Error while connecting to the local socket");
+		else if (std::this_thread::get_id() == _thread.get_id())
+			throw SocketError("Loopback request can't be sent from the serving thread");
+
+		LoopbackCommand command{listener, std::move(request), {}};
+		auto result = command.response.get_future();
+		post_command(std::move(command));
+		return result;
+	}
+
+	// Callbacks posted from any thread are run on the thread which serves requests
+	void post(std::function<void()> callback)
+	{
+		post_command(RunCommand{std::move(callback)});
+	}
+
+	void broadcast(std::function<void(HttpConnection&)> callback)
+	{
+		post_command(BroadcastCommand{std::move(callback)});
 	}
 
 private:
-	RouteTable<RequestCallback> _routes;
-	std::string _local_socket_path;
-	Socket<> _server;
-	std::vector<HttpConnection> _clients;
+	struct StopCommand {};
+	struct DrainCommand
+	{
+		std::optional<std::chrono::steady_clock::time_point> deadline;
+		std::function<void(const DrainProgress&)> progress;
+	};
+
+	struct AddRouteCommand
+	{
+		ListenerId listener;
+		std::string route;
+		std::vector<std::string> methods;
+		RequestCallback callback;
+	};
+
+	struct BroadcastCommand
+	{
+		std::function<void(HttpConnection&)> callback;
+	};
+
+	struct RunCommand
+	{
+		std::function<void()> callback;
+	};
+
+	struct LoopbackCommand
+	{
+		ListenerId listener;
+		HttpRequest request;
+		std::promise<HttpResponse> response;
+	};
+
+	using Command = std::variant<StopCommand, DrainCommand, AddRouteCommand, BroadcastCommand, RunCommand, LoopbackCommand>;
+
+	struct CachedRoute
+	{
+		std::chrono::milliseconds ttl;
+		// Headers which distinguish requests of the route besides the resource and arguments
+		std::vector<std::string> key_headers;
+	};
+
+	struct Listener
+	{
+		std::string local_socket_path;
+		Socket<> socket;
+		RouteTable<RequestCallback> routes;
+		PeerFilter peer_filter;
+		std::unordered_set<std::string, CaseInsensitiveHash, CaseInsensitiveCompare> compressed_routes;
+		// Route to the headers which distinguish its requests besides the resource and arguments
+		std::unordered_map<std::string, std::vector<std::string>, CaseInsensitiveHash, CaseInsensitiveCompare> coalesced_routes;
+		std::unordered_map<std::string, CachedRoute, CaseInsensitiveHash, CaseInsensitiveCompare> cached_routes;
+	};
+
+
+	// Zero rejects shared bodies
+	std::size_t get_max_shared_body() const
+	{
+		if (_shared_body_threshold == 0)
+			return 0;
+		return _limits.max_shared_body > 0 ? _limits.max_shared_body : std::numeric_limits<std::size_t>::max();
+	}
+
+	void check_listener(ListenerId listener) const
+	{
+		if (listener >= _listeners.size())
+			throw std::out_of_range("Unknown listener");
+	}
+
+	// Listener tokens are allocated downwards from the control token while connection IDs go upwards from 1
+	static std::uint64_t get_listener_token(ListenerId listener)
+	{
+		return ControlToken - 1 - listener;
+	}
+
+	template <typename M, typename C>
+	void add_route(ListenerId listener, const std::string& route, const M& methods, const C& callback)
+	{
+		_listeners[listener].routes.add_route(route, methods, callback);
+		_metrics.register_route(route);
+	}
+
+	void close_loopback()
+	{
+		std::lock_guard<std::mutex> lock(_loopback_mutex);
+		_loopback_open = false;
+	}
+
+	void post_command(Command&& command)
+	{
+		_commands.push(std::move(command));
+		_wakeup.notify();
+	}
+
+	void process_commands()
+	{
+		_wakeup.consume();
+		while (auto command = _commands.pop())
+		{
+			std::visit([this](auto& command) {
+				using T = std::decay_t<decltype(command)>;
+				if constexpr (std::is_same_v<T, StopCommand>)
+					_running = false;
+				else if constexpr (std::is_same_v<T, DrainCommand>)
+					start_draining(command);
+				else if constexpr (std::is_same_v<T, AddRouteCommand>)
+					add_route(command.listener, command.route, command.methods, command.callback);
+				else if constexpr (std::is_same_v<T, BroadcastCommand>)
+				{
+					for (auto& [id, connection] : _clients)
+					{
+						if (!connection.get_socket().is_closed())
+							run_callback(command.callback, connection);
+					}
+				}
+				else if constexpr (std::is_same_v<T, RunCommand>)
+					run_callback(command.callback);
+				else if constexpr (std::is_same_v<T, LoopbackCommand>)
+					handle_loopback_request(command);
+			}, *command);
+		}
+	}
+
+	template <typename Fn, typename... Args>
+	void run_callback(const Fn& callback, Args&... args)
+	{
+		try
+		{
+			callback(args...);
+		}
+		catch (const std::exception& err)
+		{
+			;
+		}
+	}
+
+	void start_draining(DrainCommand& command)
+	{
+		if (!_draining)
+		{
+			_draining = true;
+			close_loopback();
+			_drain_start = std::chrono::steady_clock::now();
+			_drain_initial_connections = _clients.size();
+			_drain_progress = DrainProgress{_clients.size(), 0, 0, 0, std::chrono::milliseconds(0), false};
+
+			for (auto& listener : _listeners)
+			{
+				_poller->remove(listener.socket.get_fd());
+				listener.socket.close();
+			}
+
+			for (auto& [id, connection] : _clients)
+			{
+				if (connection.is_idle())
+					close_connection(connection);
+			}
+		}
+
+		if (command.progress)
+			_drain_progress_callback = std::move(command.progress);
+
+		if (command.deadline)
+		{
+			_timers.cancel(_drain_timer);
+			_drain_timer = _timers.schedule(command.deadline.value(), DrainDeadlineTimer);
+		}
+	}
+
+	void force_close_connections()
+	{
+		_drain_timer = TimerWheel::InvalidTimer;
+		for (auto& [id, connection] : _clients)
+		{
+			if (!connection.get_socket().is_closed())
+			{
+				close_connection(connection);
+				++_drain_progress.forced_connections;
+			}
+		}
+	}
+
+	// Expects closed connections to be already removed
+	void update_drain_progress()
+	{
+		auto open_connections = _clients.size();
+		bool done = open_connections == 0;
+		if (open_connections == _drain_progress.open_connections && !done)
+			return;
+
+		_drain_progress.open_connections = open_connections;
+		_drain_progress.busy_connections = std::count_if(_clients.begin(), _clients.end(), [](const auto& client) {
+			return !client.second.is_idle();
+		});
+		_drain_progress.closed_connections = _drain_initial_connections - open_connections - _drain_progress.forced_connections;
+		_drain_progress.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _drain_start);
+		_drain_progress.done = done;
+
+		if (_drain_progress_callback)
+			run_callback(_drain_progress_callback, std::as_const(_drain_progress));
+
+		if (done)
+		{
+			_timers.cancel(_drain_timer);
+			_drain_timer = TimerWheel::InvalidTimer;
+			_running = false;
+		}
+	}
+
+	void accept_connections(ListenerId listener)
+	{
+		for (std::size_t accepted = 0; _limits.accepts_per_iteration == 0 || accepted < _limits.accepts_per_iteration; ++accepted)
+		{
+			if (is_at_capacity())
+				break;
+
+			std::optional<Socket<>> new_client;
+			try
+			{
+				new_client = _listeners[listener].socket.accept_connection();
+			}
+			catch (const SocketLimitError&)
+			{
+				// Listening socket stays readable so accepting has to be paused, otherwise the loop would just spin
+				// until some descriptors are released. Waiting connections stay in the backlog until then.
+				_metrics.add(ServerMetrics::RejectedConnections);
+				_accept_backoff_timer = _timers.schedule(TimerWheel::Clock::now() + _limits.accept_backoff, AcceptBackoffTimer);
+				break;
+			}
+
+			if (!new_client)
+				break;
+
+			if (_limits.overload_connections > 0 && _clients.size() >= _limits.overload_connections)
+			{
+				reject_connection(new_client.value(), _overload_response, ServerMetrics::RejectedConnections);
+				continue;
+			}
+
+			// Credentials can't change during the lifetime of the connection so they are queried just once
+			auto peer_credentials = new_client->get_peer_credentials();
+			if (!_listeners[listener].peer_filter.allows(peer_credentials))
+			{
+				reject_connection(new_client.value(), _forbidden_response, ServerMetrics::UnauthorizedConnections);
+				continue;
+			}
+
+			auto id = ++_last_connection_id;
+			auto& connection = _clients.try_emplace(id, std::move(new_client).value(), id, peer_credentials, listener).first->second;
+			_metrics.add(ServerMetrics::AcceptedConnections);
+			ULOCAL_TRACE(_trace_sink, Accept, connection.get_id(), 0);
+			_poller->add(connection.get_socket().get_fd(), id, connection.get_poll_events());
+			set_connection_phase(connection, ConnectionPhase::ReadingHeaders);
+		}
+	}
+
+	bool is_at_capacity() const
+	{
+		return _limits.max_connections > 0 && _clients.size() >= _limits.max_connections;
+	}
+
+	bool can_accept() const
+	{
+		return !is_at_capacity() && _accept_backoff_timer == TimerWheel::InvalidTimer;
+	}
+
+	// Rejection doesn't read the request at all, the response is sent only if it fits into the socket buffer right away
+	void reject_connection(Socket<>& socket, const std::string& response, ServerMetrics::Counter counter)
+	{
+		try
+		{
+			_metrics.add(ServerMetrics::BytesOut, socket.write(response));
+		}
+		catch (const std::exception&)
+		{
+			;
+		}
+		socket.close();
+		_metrics.add(counter);
+	}
+
+	std::string create_rejection_response(int status_code) const
+	{
+		HttpResponse response{status_code};
+		response.calculate_content_length();
+		if (_server_header)
+			response.add_header(HttpHeaderId::Server, _server_header.value());
+		response.add_header(HttpHeaderId::Connection, "close");
+		if (status_code == 503)
+			response.add_header("Retry-After", 1);
+		response.add_header("X-Framework", "ulocal " ULOCAL_VERSION);
+		return response.dump();
+	}
+
+	void handle_connection(HttpConnection& connection, short revents)
+	{
+		if (revents & POLLOUT)
+		{
+			flush_connection(connection);
+			if (!connection.get_socket().is_closed() && !connection.has_pending_output())
+				process_requests(connection);
+		}
+		else if (revents & POLLIN)
+		{
+			bool peer_open = true;
+			try
+			{
+				auto size_before = connection.get_socket().get_stream().get_size();
+				peer_open = connection.get_socket().read();
+				_metrics.add(ServerMetrics::BytesIn, connection.get_socket().get_stream().get_size() - size_before);
+				ULOCAL_TRACE(_trace_sink, ReadComplete, connection.get_id(), 0);
+			}
+			catch (const std::exception& err)
+			{
+				close_connection(connection);
+				return;
+			}
+
+			process_requests(connection);
+
+			// Client won't send anything else so there is nothing to wait for once the responses are out
+			if (!peer_open && !connection.has_pending_output())
+				close_connection(connection);
+		}
+
+		if (revents & (POLLHUP | POLLERR))
+			close_connection(connection);
+	}
+
+	void process_requests(HttpConnection& connection)
+	{
+		while (!connection.get_socket().is_closed() && !connection.has_pending_output())
+		{
+			std::optional<HttpResponse> response;
+			RouteMetrics* route_metrics = nullptr;
+			bool keep_alive = false;
+			bool accepts_shared_body = false;
+
+			std::uint64_t request_id = 0;
+			std::optional<HttpRequest> maybe_request;
+			auto parse_start = std::chrono::steady_clock::now();
+			try
+			{
+				maybe_request = connection.get_request(get_max_shared_body());
+				if (maybe_request)
+				{
+					_metrics.record_parse_time(detail::elapsed_ns(parse_start));
+					request_id = ++_last_request_id;
+					ULOCAL_TRACE(_trace_sink, RequestParsed, connection.get_id(), request_id);
+				}
+			}
+			catch (const ParseError&)
+			{
+				_metrics.add(ServerMetrics::ParseErrors);
+				response = HttpResponse{400};
+			}
+
+			if (maybe_request)
+			{
+				auto request = std::move(maybe_request).value();
+				request.set_peer_credentials(connection.get_peer_credentials());
+				auto connection_header = request.get_header(HttpHeaderId::Connection);
+				keep_alive = _keep_alive && !_draining && connection_header && icase_equal(connection_header->get_value(), "keep-alive");
+				accepts_shared_body = _shared_body_threshold > 0 && request.has_header(AcceptSharedBodyHeader);
+				route_metrics = _metrics.find_route(request.get_resource());
+
+				auto cache_key = get_cache_key(connection.get_listener(), request);
+				if (cache_key)
+				{
+					if (auto cached = find_cached_response(cache_key.value()))
+					{
+						send_serialized_response(connection, request_id, cached->serialized[keep_alive ? 1 : 0], cached->response.get_status_code(), route_metrics, keep_alive);
+						continue;
+					}
+				}
+
+				if (auto flight_key = get_flight_key(connection.get_listener(), request))
+				{
+					auto& flight = get_flight(connection.get_listener(), connection.get_id(), request_id, request, route_metrics, std::move(flight_key).value());
+					if (cache_key)
+						cache_response(connection.get_listener(), request, std::move(cache_key).value(), flight.response);
+					send_flight_response(connection, request_id, flight, route_metrics, keep_alive);
+					continue;
+				}
+
+				response = handle_request(connection.get_listener(), connection.get_id(), request_id, request, route_metrics);
+				compress_response(connection.get_listener(), request, response.value());
+				if (cache_key)
+					cache_response(connection.get_listener(), request, std::move(cache_key).value(), response.value());
+			}
+
+			if (!response)
+				break;
+
+			send_response(connection, request_id, std::move(response).value(), route_metrics, keep_alive, accepts_shared_body);
+		}
+
+		if (!connection.get_socket().is_closed() && !connection.has_pending_output())
+			set_connection_phase(connection, connection.get_read_phase());
+	}
+
+	void send_response(HttpConnection& connection, std::uint64_t request_id, HttpResponse&& response, RouteMetrics* route_metrics, bool keep_alive, bool accepts_shared_body)
+	{
+		if (accepts_shared_body && response.get_content().length() >= _shared_body_threshold)
+			share_body(response);
+
+		finish_response(response, route_metrics, keep_alive);
+		auto data = response.dump();
+		connection.send(std::move(data), request_id, keep_alive, response.release_fds());
+		ULOCAL_TRACE(_trace_sink, ResponseSerialized, connection.get_id(), request_id);
+		flush_connection(connection);
+	}
+
+	void send_flight_response(HttpConnection& connection, std::uint64_t request_id, CachedResponse& flight, RouteMetrics* route_metrics, bool keep_alive)
+	{
+		// File descriptors can't be part of the serialized response, every request gets its own duplicates
+		if (!flight.response.get_fds().empty())
+			return send_response(connection, request_id, HttpResponse{flight.response}, route_metrics, keep_alive, false);
+
+		auto& serialized = flight.serialized[keep_alive ? 1 : 0];
+		if (!serialized)
+			serialized = serialize_response(flight.response, keep_alive);
+		send_serialized_response(connection, request_id, serialized, flight.response.get_status_code(), route_metrics, keep_alive);
+	}
+
+	void send_serialized_response(HttpConnection& connection, std::uint64_t request_id, const std::shared_ptr<const std::string>& data, int status_code, RouteMetrics* route_metrics, bool keep_alive)
+	{
+		if (route_metrics)
+			route_metrics->record_response(status_code);
+
+		connection.send(data, request_id, keep_alive);
+		ULOCAL_TRACE(_trace_sink, ResponseSerialized, connection.get_id(), request_id);
+		flush_connection(connection);
+	}
+
+	std::shared_ptr<const std::string> serialize_response(HttpResponse response, bool keep_alive) const
+	{
+		prepare_response(response, keep_alive);
+		return std::make_shared<const std::string>(response.dump());
+	}
+
+	// Only requests without content can share the response with other requests
+	static bool is_shareable_request(const HttpRequest& request)
+	{
+		return request.get_content().empty() && request.get_fds().empty()
+			&& (icase_equal(request.get_method(), "GET") || icase_equal(request.get_method(), "HEAD"));
+	}
+
+	std::optional<std::string> get_flight_key(ListenerId listener, const HttpRequest& request) const
+	{
+		const auto& coalesced_routes = _listeners[listener].coalesced_routes;
+		auto route_itr = coalesced_routes.find(request.get_resource());
+		if (route_itr == coalesced_routes.end() || !is_shareable_request(request))
+			return std::nullopt;
+		return get_request_key(listener, request, route_itr->second);
+	}
+
+	std::optional<std::string> get_cache_key(ListenerId listener, const HttpRequest& request) const
+	{
+		if (!_response_cache)
+			return std::nullopt;
+
+		// Conditional requests have to reach the validator of the endpoint
+		const auto& cached_routes = _listeners[listener].cached_routes;
+		auto route_itr = cached_routes.find(request.get_resource());
+		if (route_itr == cached_routes.end() || !is_shareable_request(request)
+			|| request.has_header(HttpHeaderId::IfNoneMatch) || request.has_header(HttpHeaderId::IfModifiedSince))
+			return std::nullopt;
+		return get_request_key(listener, request, route_itr->second.key_headers);
+	}
+
+	std::string get_request_key(ListenerId listener, const HttpRequest& request, const std::vector<std::string>& key_headers) const
+	{
+		// Every part is prefixed by its length so different requests can't end up with the same key
+		std::string result;
+		auto append_part = [&result](std::string_view part) {
+			append_number(result, part.length());
+			result.push_back(':');
+			result.append(part);
+		};
+
+		append_number(result, listener);
+		result.push_back(':');
+		append_part(request.get_method());
+		append_part(request.get_resource());
+
+		std::vector<std::pair<std::string_view, std::string_view>> args;
+		for (const auto& arg : request.get_arguments())
+			args.emplace_back(arg.get_name(), arg.get_value());
+		std::sort(args.begin(), args.end());
+		for (const auto& [name, value] : args)
+		{
+			append_part(name);
+			append_part(value);
+		}
+
+		// Representation of compressed routes depends on what the client accepts
+		auto append_header = [&](std::string_view name) {
+			auto header = request.get_header(name);
+			result.push_back(header ? '+' : '-');
+			if (header)
+				append_part(header->get_value());
+		};
+		for (const auto& name : key_headers)
+			append_header(name);
+		if (_listeners[listener].compressed_routes.count(request.get_resource()))
+			append_header(get_header_name(HttpHeaderId::AcceptEncoding));
+
+		return result;
+	}
+
+	// Returns the flight of identical request handled earlier in this iteration or handles the request and starts a new flight
+	CachedResponse& get_flight(ListenerId listener, std::uint64_t connection_id, std::uint64_t request_id, const HttpRequest& request, RouteMetrics* route_metrics, std::string&& key)
+	{
+		auto itr = _flights.find(key);
+		if (itr != _flights.end())
+		{
+			_metrics.add(ServerMetrics::CoalescedRequests);
+			return itr->second;
+		}
+
+		auto response = handle_request(listener, connection_id, request_id, request, route_metrics);
+		compress_response(listener, request, response);
+		return _flights.emplace(std::move(key), CachedResponse{std::move(response), {}}).first->second;
+	}
+
+	std::shared_ptr<const CachedResponse> find_cached_response(const std::string& key)
+	{
+		auto result = _response_cache->find(key);
+		_metrics.add(result ? ServerMetrics::CacheHits : ServerMetrics::CacheMisses);
+		return result;
+	}
+
+	void cache_response(ListenerId listener, const HttpRequest& request, std::string&& key, const HttpResponse& response)
+	{
+		if (response.get_status_code() != 200 || !response.get_fds().empty())
+			return;
+
+		auto cached = std::make_shared<CachedResponse>(CachedResponse{response, {serialize_response(response, false), serialize_response(response, true)}});
+		auto expires = ResponseCache::Clock::now() + _listeners[listener].cached_routes.at(request.get_resource()).ttl;
+		_response_cache->insert(std::move(key), request.get_resource(), std::move(cached), expires);
+	}
+
+	void finish_response(HttpResponse& response, RouteMetrics* route_metrics, bool keep_alive)
+	{
+		if (route_metrics)
+			route_metrics->record_response(response.get_status_code());
+		prepare_response(response, keep_alive);
+	}
+
+	void prepare_response(HttpResponse& response, bool keep_alive) const
+	{
+		response.calculate_content_length();
+		if (_server_header)
+			response.add_header(HttpHeaderId::Server, _server_header.value());
+		response.add_header(HttpHeaderId::Connection, keep_alive ? "keep-alive" : "close");
+		response.add_header("X-Framework", "ulocal " ULOCAL_VERSION);
+	}
+
+	void compress_response([[maybe_unused]] ListenerId listener, [[maybe_unused]] const HttpRequest& request, [[maybe_unused]] HttpResponse& response)
+	{
+#ifdef ULOCAL_COMPRESSION
+		auto status_code = response.get_status_code();
+		if (status_code == 204 || status_code < 200)
+			return;
+
+		const auto& compressed_routes = _listeners[listener].compressed_routes;
+		if (compressed_routes.find(request.get_resource()) == compressed_routes.end())
+			return;
+
+		// Encoded representation can't share the strong tag of the identity one. Clients which accept other encoding
+		// get the weak tag even if the content ends up not compressed, so it's the same in 200 and 304 responses.
+		// Validator of the endpoint still matches it since If-None-Match is compared the weak way.
+		auto accept_encoding = request.get_header(HttpHeaderId::AcceptEncoding);
+		auto encoding = accept_encoding ? negotiate_content_encoding(accept_encoding->get_value()) : ContentEncoding::Identity;
+		if (encoding != ContentEncoding::Identity)
+			weaken_etag(response);
+
+		if (status_code == 304)
+			return;
+
+		// Representation depends on Accept-Encoding of the request no matter which encoding is picked in the end
+		if (!response.has_header(HttpHeaderId::Vary))
+			response.add_header(HttpHeaderId::Vary, "Accept-Encoding");
+
+		const auto& content = response.get_content();
+		if (encoding == ContentEncoding::Identity || content.empty() || content.length() < _compression.min_size || response.has_header(HttpHeaderId::ContentEncoding) || response.has_header(SharedBodyHeader))
+			return;
+
+		std::string compressed;
+		try
+		{
+			compressed = compress(content, encoding, _compression.level);
+		}
+		catch (const CompressionError&)
+		{
+			return;
+		}
+
+		// Incompressible content is better left alone than sent bigger with the decoding cost on top
+		if (compressed.length() >= content.length())
+			return;
+
+		response.remove_header(get_header_name(HttpHeaderId::ContentLength));
+		response.add_header(HttpHeaderId::ContentEncoding, std::string{get_content_encoding_name(encoding)});
+		response.set_content(std::move(compressed));
+#endif
+	}
+
+	void handle_loopback_request(LoopbackCommand& command)
+	{
+		// Listeners are closed once the server starts draining so new clients can't connect anymore
+		if (_draining)
+		{
+			command.response.set_exception(std::make_exception_ptr(SocketError("Error while connecting to the local socket")));
+			return;
+		}
+
+		// Peer of the loopback transport is always this process
+		auto peer_credentials = PeerCredentials{::getpid(), ::geteuid(), ::getegid()};
+		if (!_listeners[command.listener].peer_filter.allows(peer_credentials))
+		{
+			HttpResponse response{403};
+			finish_response(response, nullptr, false);
+			_metrics.add(ServerMetrics::UnauthorizedConnections);
+			command.response.set_value(std::move(response));
+			return;
+		}
+
+		auto& request = command.request;
+		request.set_peer_credentials(peer_credentials);
+		auto request_id = ++_last_request_id;
+		ULOCAL_TRACE(_trace_sink, RequestParsed, 0, request_id);
+
+		auto connection_header = request.get_header(HttpHeaderId::Connection);
+		bool keep_alive = _keep_alive && connection_header && icase_equal(connection_header->get_value(), "keep-alive");
+		auto route_metrics = _metrics.find_route(request.get_resource());
+		std::optional<HttpResponse> response;
+		auto cache_key = get_cache_key(command.listener, request);
+		if (auto cached = cache_key ? find_cached_response(cache_key.value()) : nullptr)
+			response = cached->response;
+		else
+		{
+			if (auto flight_key = get_flight_key(command.listener, request))
+				response = get_flight(command.listener, 0, request_id, request, route_metrics, std::move(flight_key).value()).response;
+			else
+			{
+				response = handle_request(command.listener, 0, request_id, request, route_metrics);
+				compress_response(command.listener, request, response.value());
+			}
+
+			if (cache_key)
+				cache_response(command.listener, request, std::move(cache_key).value(), response.value());
+		}
+		finish_response(response.value(), route_metrics, keep_alive);
+		ULOCAL_TRACE(_trace_sink, ResponseSerialized, 0, request_id);
+		command.response.set_value(std::move(response).value());
+	}
+
+	void flush_connection(HttpConnection& connection)
+	{
+		auto write_start = std::chrono::steady_clock::now();
+		try
+		{
+			_metrics.add(ServerMetrics::BytesOut, connection.flush());
+		}
+		catch (const std::exception& err)
+		{
+			close_connection(connection);
+			return;
+		}
+		_metrics.record_write_time(detail::elapsed_ns(write_start));
+
+		// Write timeout is restarted with every write so only clients which stopped reading are disconnected
+		if (connection.has_pending_output())
+		{
+			set_connection_phase(connection, ConnectionPhase::Writing);
+			return;
+		}
+
+		ULOCAL_TRACE(_trace_sink, WriteComplete, connection.get_id(), connection.get_request_id());
+		if (connection.is_keep_alive())
+			set_connection_phase(connection, ConnectionPhase::Idle);
+		else
+			close_connection(connection);
+	}
+
+	void update_poll_events(HttpConnection& connection)
+	{
+		if (connection.get_socket().is_closed())
+			return;
+
+		// Don't read any further requests until the client picks up the pending response
+		short events = connection.has_pending_output() ? POLLOUT : POLLIN;
+		if (events != connection.get_poll_events())
+		{
+			connection.set_poll_events(events);
+			_poller->modify(connection.get_socket().get_fd(), connection.get_id(), events);
+		}
+	}
+
+	void set_connection_phase(HttpConnection& connection, ConnectionPhase phase)
+	{
+		// Reading deadlines are not extended by data trickling in, otherwise a slow client could hold the connection forever
+		if (phase == connection.get_phase() && phase != ConnectionPhase::Writing && connection.get_timer() != TimerWheel::InvalidTimer)
+			return;
+
+		_timers.cancel(connection.get_timer());
+		connection.set_timer(TimerWheel::InvalidTimer);
+		connection.set_phase(phase);
+
+		auto timeout = get_timeout(phase);
+		if (timeout.count() > 0)
+			connection.set_timer(_timers.schedule(TimerWheel::Clock::now() + timeout, connection.get_id()));
+	}
+
+	std::chrono::milliseconds get_timeout(ConnectionPhase phase) const
+	{
+		switch (phase)
+		{
+			case ConnectionPhase::Idle:
+				return _timeouts.idle;
+			case ConnectionPhase::ReadingHeaders:
+				return _timeouts.header;
+			case ConnectionPhase::ReadingContent:
+				return _timeouts.content;
+			case ConnectionPhase::Writing:
+				return _timeouts.write;
+		}
+		return std::chrono::milliseconds(0);
+	}
+
+	int get_poll_timeout() const
+	{
+		auto timeout = _timers.time_until_next(TimerWheel::Clock::now());
+		if (!timeout)
+			return -1;
+		return static_cast<int>(std::min<std::chrono::milliseconds::rep>(timeout->count(), std::numeric_limits<int>::max()));
+	}
+
+	void expire_timers()
+	{
+		_timers.advance(TimerWheel::Clock::now(), [this](std::uint64_t id) {
+			if (id == DrainDeadlineTimer)
+			{
+				force_close_connections();
+				return;
+			}
+			else if (id == AcceptBackoffTimer)
+			{
+				_accept_backoff_timer = TimerWheel::InvalidTimer;
+				return;
+			}
+
+			auto itr = _clients.find(id);
+			if (itr == _clients.end())
+				return;
+
+			itr->second.set_timer(TimerWheel::InvalidTimer);
+			_metrics.add(ServerMetrics::TimedOutConnections);
+			close_connection(itr->second);
+		});
+	}
+
+	HttpResponse handle_request(ListenerId listener, [[maybe_unused]] std::uint64_t connection_id, [[maybe_unused]] std::uint64_t request_id, const HttpRequest& request, RouteMetrics* route_metrics)
+	{
+		const auto& routes = _listeners[listener].routes;
+		if (!routes.has_route(request.get_resource()))
+			return 404;
+		else if (!routes.has_route_for_method(request.get_resource(), request.get_method()))
+			return 405;
+
+		ULOCAL_TRACE(_trace_sink, RouteResolved, connection_id, request_id);
+
+		std::optional<HttpResponse> response;
+		auto handler_start = std::chrono::steady_clock::now();
+		ULOCAL_TRACE(_trace_sink, HandlerStart, connection_id, request_id);
+		try
+		{
+			response = routes.perform_action(request.get_resource(), request.get_method(), request);
+		}
+		catch (const std::exception& err)
+		{
+			response = HttpResponse{500};
+		}
+		ULOCAL_TRACE(_trace_sink, HandlerEnd, connection_id, request_id);
+
+		auto handler_time = detail::elapsed_ns(handler_start);
+		_metrics.record_handler_time(handler_time);
+		route_metrics->record_handler_time(handler_time);
+		return std::move(response).value();
+	}
+
+	void close_connection(HttpConnection& connection)
+	{
+		if (!connection.get_socket().is_closed())
+		{
+			_poller->remove(connection.get_socket().get_fd());
+			connection.get_socket().close();
+			_timers.cancel(connection.get_timer());
+			connection.set_timer(TimerWheel::InvalidTimer);
+			_metrics.add(ServerMetrics::ClosedConnections);
+			ULOCAL_TRACE(_trace_sink, Close, connection.get_id(), 0);
+		}
+	}
+
+	static constexpr std::uint64_t ControlToken = ~std::uint64_t{0};
+	// Connection IDs start at 1 and never get as high as ControlToken so these timers can't belong to any connection
+	static constexpr std::uint64_t DrainDeadlineTimer = 0;
+	static constexpr std::uint64_t AcceptBackoffTimer = ControlToken;
+
+	std::vector<Listener> _listeners;
+	std::unordered_map<std::uint64_t, HttpConnection> _clients;
 
 	std::thread _thread;
-	Pipe _control_pipe;
+	EventFd _wakeup;
+	MpscQueue<Command> _commands;
+	bool _running;
+	std::mutex _loopback_mutex;
+	bool _loopback_open;
+	bool _draining;
+	std::chrono::steady_clock::time_point _drain_start;
+	std::size_t _drain_initial_connections;
+	DrainProgress _drain_progress;
+	std::function<void(const DrainProgress&)> _drain_progress_callback;
+	TimerWheel::TimerId _drain_timer;
 
 	std::optional<std::string> _server_header;
+	ServerMetrics _metrics;
+
+	TraceSink* _trace_sink;
+	std::uint64_t _last_connection_id;
+	std::uint64_t _last_request_id;
+
+	TimerWheel _timers;
+	HttpServerTimeouts _timeouts;
+	bool _keep_alive;
+
+	HttpServerLimits _limits;
+	std::string _overload_response;
+	std::string _forbidden_response;
+	std::size_t _shared_body_threshold;
+	HttpServerCompression _compression;
+	std::unordered_map<std::string, CachedResponse> _flights;
+	std::unique_ptr<ResponseCache> _response_cache;
+
+	PollerBackend _poller_backend;
+	std::unique_ptr<Poller> _poller;
+	bool _accepting;
+	TimerWheel::TimerId _accept_backoff_timer;
 };
 
 } // namespace ulocal
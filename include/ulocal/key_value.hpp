@@ -1,6 +1,11 @@
 #pragma once
 
+#include <charconv>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 #include <ulocal/utils.hpp>
 
@@ -14,50 +19,79 @@ struct ValueGetter {};
 template <typename T>
 struct ValueGetter<T>
 {
-	using allow = std::enable_if_t<std::is_integral_v<T>, void>;
+	using allow = std::enable_if_t<std::is_arithmetic_v<T>, void>;
 
-	static T convert(const std::string& str) { return std::stol(str); }
+	static std::optional<T> convert(std::string_view str)
+	{
+		str = strip(str);
+
+		T result;
+		auto [end, error] = std::from_chars(str.data(), str.data() + str.length(), result);
+		if (error != std::errc{} || end != str.data() + str.length())
+			return std::nullopt;
+
+		return result;
+	}
 };
 
 template <>
 struct ValueGetter<bool>
 {
-	static bool convert(const std::string& str) { return icase_compare(str, "true"); }
+	static std::optional<bool> convert(std::string_view str)
+	{
+		if (icase_equal(str, "true"))
+			return true;
+		else if (icase_equal(str, "false"))
+			return false;
+		return std::nullopt;
+	}
 };
 
+// Values are written right into the storage of the value so replacing the value reuses its buffer
 template <typename... Args>
 struct ValueSetter {};
 
 template <>
 struct ValueSetter<char*>
 {
-	static std::string convert(char* value) { return value; }
+	static void assign(std::string& out, char* value) { out = value; }
 };
 
 template <>
 struct ValueSetter<const char*>
 {
-	static std::string convert(const char* value) { return value; }
+	static void assign(std::string& out, const char* value) { out = value; }
 };
 
 template <>
 struct ValueSetter<std::string>
 {
-	static std::string convert(const std::string& value) { return value; }
+	static void assign(std::string& out, const std::string& value) { out = value; }
+	static void assign(std::string& out, std::string&& value) { out = std::move(value); }
+};
+
+template <>
+struct ValueSetter<std::string_view>
+{
+	static void assign(std::string& out, std::string_view value) { out.assign(value); }
 };
 
 template <>
 struct ValueSetter<bool>
 {
-	static std::string convert(bool value) { return value ? "true" : "false"; }
+	static void assign(std::string& out, bool value) { out = value ? "true" : "false"; }
 };
 
 template <typename T>
 struct ValueSetter<T>
 {
-	using allow = std::enable_if_t<std::is_integral_v<T>, bool>;
+	using allow = std::enable_if_t<std::is_arithmetic_v<T>, bool>;
 
-	static std::string convert(T value) { return std::to_string(value); }
+	static void assign(std::string& out, T value)
+	{
+		out.clear();
+		append_number(out, value);
+	}
 };
 
 }
@@ -66,21 +100,38 @@ class KeyValue
 {
 public:
 	template <typename Name, typename Value>
-	KeyValue(Name&& name, Value&& value) : _name(std::forward<Name>(name)), _value(detail::ValueSetter<std::decay_t<Value>>::convert(value)) {}
+	KeyValue(Name&& name, Value&& value) : _name(std::forward<Name>(name)), _value()
+	{
+		detail::ValueSetter<std::decay_t<Value>>::assign(_value, std::forward<Value>(value));
+	}
 
 	const std::string& get_name() const { return _name; }
 	const std::string& get_value() const { return _value; }
 
 	template <typename T>
-	T get_value_as() const
+	std::optional<T> try_get_value_as() const
 	{
 		return detail::ValueGetter<T>::convert(_value);
 	}
 
+	template <typename T>
+	T get_value_as() const
+	{
+		auto result = try_get_value_as<T>();
+		if constexpr (std::is_same_v<T, bool>)
+			return result.value_or(false);
+		else
+		{
+			if (!result)
+				throw std::invalid_argument("Value '" + _value + "' of '" + _name + "' is not convertible to requested type");
+			return result.value();
+		}
+	}
+
 	template <typename Value>
-	void set_value(const Value& value)
+	void set_value(Value&& value)
 	{
-		_value = detail::ValueSetter<std::decay_t<Value>>::convert(value);
+		detail::ValueSetter<std::decay_t<Value>>::assign(_value, std::forward<Value>(value));
 	}
 
 private:
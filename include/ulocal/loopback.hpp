@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <future>
+
+#include <ulocal/http_request.hpp>
+#include <ulocal/http_response.hpp>
+
+namespace ulocal {
+
+// Server which HttpClient in the same process can send requests to directly, without going through a socket
+class LoopbackTransport
+{
+public:
+	virtual ~LoopbackTransport() = default;
+
+	virtual std::future<HttpResponse> submit(HttpRequest&& request, std::size_t listener) = 0;
+};
+
+} // namespace ulocal
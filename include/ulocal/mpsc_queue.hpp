@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace ulocal {
+
+// Unbounded lock-free queue with any number of producers and a single consumer. Producers never wait
+// for each other, a producer preempted in the middle of push only delays the items pushed after it.
+template <typename T>
+class MpscQueue
+{
+public:
+	MpscQueue() : _head(new Node{}), _tail(_head.load(std::memory_order_relaxed)) {}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	~MpscQueue()
+	{
+		while (pop())
+			;
+		delete _tail;
+	}
+
+	void push(T value)
+	{
+		auto* node = new Node{std::move(value)};
+		auto* prev = _head.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	// Can only be called from the consumer thread
+	std::optional<T> pop()
+	{
+		auto* tail = _tail;
+		auto* next = tail->next.load(std::memory_order_acquire);
+		if (!next)
+			return std::nullopt;
+
+		std::optional<T> result = std::move(next->value);
+		next->value.reset();
+		_tail = next;
+		delete tail;
+		return result;
+	}
+
+private:
+	struct Node
+	{
+		std::optional<T> value;
+		std::atomic<Node*> next = nullptr;
+	};
+
+	alignas(64) std::atomic<Node*> _head;
+	alignas(64) Node* _tail;
+};
+
+} // namespace ulocal
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <sys/types.h>
+
+namespace ulocal {
+
+// Identity of the process on the other side of the local socket at the time it connected
+struct PeerCredentials
+{
+	pid_t pid;
+	uid_t uid;
+	gid_t gid;
+};
+
+} // namespace ulocal
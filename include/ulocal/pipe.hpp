@@ -3,6 +3,7 @@
 #include <memory>
 #include <stdexcept>
 
+#include <fcntl.h>
 #include <unistd.h>
 
 #include <ulocal/socket.hpp>
@@ -15,7 +16,7 @@ public:
 	Pipe() : _read_socket(), _write_socket()
 	{
 		int fds[2];
-		if (::pipe(fds) != 0)
+		if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) != 0)
 			throw std::runtime_error("Unable to create pipe");
 
 		_read_socket = std::make_unique<Socket<NonNetwork>>(fds[0]);
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
+
+namespace ulocal {
+
+class PollerError : public std::exception
+{
+public:
+	PollerError(const char* msg) noexcept : _msg(msg) {}
+
+	virtual const char* what() const noexcept { return _msg; }
+
+private:
+	const char* _msg;
+};
+
+enum class PollerBackend
+{
+	Auto,
+	Epoll,
+	Poll
+};
+
+constexpr std::string_view get_poller_backend_name(PollerBackend backend)
+{
+	switch (backend)
+	{
+		case PollerBackend::Auto:
+			return "auto";
+		case PollerBackend::Epoll:
+			return "epoll";
+		case PollerBackend::Poll:
+			return "poll";
+	}
+	return "unknown";
+}
+
+struct PollEvent
+{
+	std::uint64_t token;
+	short events;
+};
+
+// Level-triggered readiness notifications for a set of file descriptors. Events use the same bits as poll(2).
+// File descriptors have to be removed before they are closed.
+class Poller
+{
+public:
+	virtual ~Poller() = default;
+
+	virtual PollerBackend get_backend() const = 0;
+
+	virtual void add(int fd, std::uint64_t token, short events) = 0;
+	virtual void modify(int fd, std::uint64_t token, short events) = 0;
+	virtual void remove(int fd) = 0;
+
+	// Waits at most timeout_ms milliseconds (-1 waits indefinitely) and replaces the content of events with the ready ones
+	virtual void wait(std::vector<PollEvent>& events, int timeout_ms) = 0;
+};
+
+class PollPoller : public Poller
+{
+public:
+	PollPoller() : _fds(), _tokens(), _indices() {}
+
+	virtual PollerBackend get_backend() const override { return PollerBackend::Poll; }
+
+	virtual void add(int fd, std::uint64_t token, short events) override
+	{
+		_indices[fd] = _fds.size();
+		_fds.push_back({fd, events, 0});
+		_tokens.push_back(token);
+	}
+
+	virtual void modify(int fd, std::uint64_t token, short events) override
+	{
+		auto itr = _indices.find(fd);
+		if (itr == _indices.end())
+			return;
+
+		_fds[itr->second].events = events;
+		_tokens[itr->second] = token;
+	}
+
+	virtual void remove(int fd) override
+	{
+		auto itr = _indices.find(fd);
+		if (itr == _indices.end())
+			return;
+
+		auto index = itr->second;
+		_indices.erase(itr);
+		if (index + 1 != _fds.size())
+		{
+			_fds[index] = _fds.back();
+			_tokens[index] = _tokens.back();
+			_indices[_fds[index].fd] = index;
+		}
+		_fds.pop_back();
+		_tokens.pop_back();
+	}
+
+	virtual void wait(std::vector<PollEvent>& events, int timeout_ms) override
+	{
+		events.clear();
+		auto result = ::poll(_fds.data(), _fds.size(), timeout_ms);
+		if (result == -1)
+		{
+			if (errno == EINTR)
+				return;
+			throw PollerError("Failed while polling file descriptors");
+		}
+
+		for (std::size_t i = 0; i < _fds.size() && events.size() < static_cast<std::size_t>(result); ++i)
+		{
+			if (_fds[i].revents != 0)
+				events.push_back({_tokens[i], _fds[i].revents});
+		}
+	}
+
+private:
+	std::vector<pollfd> _fds;
+	std::vector<std::uint64_t> _tokens;
+	std::unordered_map<int, std::size_t> _indices;
+};
+
+#if defined(__linux__)
+class EpollPoller : public Poller
+{
+public:
+	EpollPoller() : _fd(::epoll_create1(EPOLL_CLOEXEC)), _events(256)
+	{
+		if (_fd < 0)
+			throw PollerError("Unable to create epoll instance");
+	}
+
+	EpollPoller(const EpollPoller&) = delete;
+	EpollPoller& operator=(const EpollPoller&) = delete;
+
+	virtual ~EpollPoller() override
+	{
+		::close(_fd);
+	}
+
+	virtual PollerBackend get_backend() const override { return PollerBackend::Epoll; }
+
+	virtual void add(int fd, std::uint64_t token, short events) override
+	{
+		control(EPOLL_CTL_ADD, fd, token, events);
+	}
+
+	virtual void modify(int fd, std::uint64_t token, short events) override
+	{
+		control(EPOLL_CTL_MOD, fd, token, events);
+	}
+
+	virtual void remove(int fd) override
+	{
+		::epoll_ctl(_fd, EPOLL_CTL_DEL, fd, nullptr);
+	}
+
+	virtual void wait(std::vector<PollEvent>& events, int timeout_ms) override
+	{
+		events.clear();
+		auto result = ::epoll_wait(_fd, _events.data(), static_cast<int>(_events.size()), timeout_ms);
+		if (result == -1)
+		{
+			if (errno == EINTR)
+				return;
+			throw PollerError("Failed while waiting for epoll events");
+		}
+
+		for (int i = 0; i < result; ++i)
+			events.push_back({_events[i].data.u64, static_cast<short>(_events[i].events)});
+	}
+
+private:
+	void control(int operation, int fd, std::uint64_t token, short events)
+	{
+		// EPOLLIN, EPOLLOUT, EPOLLERR and EPOLLHUP have the same values as their poll(2) counterparts
+		epoll_event event = {};
+		event.events = static_cast<std::uint16_t>(events);
+		event.data.u64 = token;
+		if (::epoll_ctl(_fd, operation, fd, &event) < 0)
+			throw PollerError("Unable to update epoll interest list");
+	}
+
+	int _fd;
+	std::vector<epoll_event> _events;
+};
+#endif
+
+// PollerBackend::Auto uses epoll where available and poll everywhere else.
+inline std::unique_ptr<Poller> create_poller(PollerBackend backend = PollerBackend::Auto)
+{
+#if defined(__linux__)
+	if (backend != PollerBackend::Poll)
+		return std::make_unique<EpollPoller>();
+#endif
+
+	return std::make_unique<PollPoller>();
+}
+
+} // namespace ulocal
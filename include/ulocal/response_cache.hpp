@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <ulocal/http_response.hpp>
+
+namespace ulocal {
+
+// Response together with its serialized forms for connections which are closed after it and the ones which are kept alive
+struct CachedResponse
+{
+	HttpResponse response;
+	std::array<std::shared_ptr<const std::string>, 2> serialized;
+
+	std::size_t get_size() const
+	{
+		std::size_t result = sizeof(CachedResponse) + response.get_content().length();
+		for (const auto& data : serialized)
+			result += data ? data->length() : 0;
+		return result;
+	}
+};
+
+// Cache of immutable responses split into shards with their own lock and their own part of the memory budget, so
+// lookups only contend with operations on the same shard. Entries expire after their TTL and when a shard runs out
+// of its budget, entries are evicted by CLOCK (second chance) algorithm which approximates LRU without reordering
+// anything on lookup.
+class ResponseCache
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	ResponseCache(std::size_t memory_budget, std::size_t shard_count = 8)
+		: _shard_budget(memory_budget / std::max(shard_count, std::size_t{1})), _shards(std::max(shard_count, std::size_t{1})) {}
+
+	ResponseCache(const ResponseCache&) = delete;
+	ResponseCache& operator=(const ResponseCache&) = delete;
+
+	std::shared_ptr<const CachedResponse> find(const std::string& key, Clock::time_point now = Clock::now())
+	{
+		auto& shard = get_shard(key);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		auto itr = shard.index.find(key);
+		if (itr == shard.index.end())
+			return nullptr;
+
+		auto& entry = shard.entries[itr->second];
+		if (entry.expires <= now)
+		{
+			remove(shard, itr->second);
+			return nullptr;
+		}
+
+		entry.referenced = true;
+		return entry.value;
+	}
+
+	// Entries which don't fit into the budget of a single shard are not cached at all. Returns whether the entry was cached.
+	bool insert(std::string key, std::string resource, std::shared_ptr<const CachedResponse> value, Clock::time_point expires)
+	{
+		auto size = key.length() + resource.length() + value->get_size();
+		if (size > _shard_budget)
+			return false;
+
+		auto& shard = get_shard(key);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		if (auto itr = shard.index.find(key); itr != shard.index.end())
+			remove(shard, itr->second);
+
+		while (shard.memory_usage + size > _shard_budget)
+			evict(shard);
+
+		shard.index.emplace(key, shard.entries.size());
+		shard.entries.push_back(Entry{std::move(key), std::move(resource), std::move(value), size, expires, false});
+		shard.memory_usage += size;
+		return true;
+	}
+
+	// Removes all entries of resources starting with the prefix, can be called from any thread. Returns number of removed entries.
+	std::size_t invalidate(std::string_view resource_prefix)
+	{
+		std::size_t result = 0;
+		for (auto& shard : _shards)
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			for (auto i = shard.entries.size(); i > 0; --i)
+			{
+				if (std::string_view{shard.entries[i - 1].resource}.substr(0, resource_prefix.length()) == resource_prefix)
+				{
+					remove(shard, i - 1);
+					++result;
+				}
+			}
+		}
+		return result;
+	}
+
+	void clear()
+	{
+		invalidate({});
+	}
+
+	std::size_t get_memory_usage() const
+	{
+		std::size_t result = 0;
+		for (const auto& shard : _shards)
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			result += shard.memory_usage;
+		}
+		return result;
+	}
+
+	std::size_t size() const
+	{
+		std::size_t result = 0;
+		for (const auto& shard : _shards)
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			result += shard.entries.size();
+		}
+		return result;
+	}
+
+private:
+	struct Entry
+	{
+		std::string key;
+		std::string resource;
+		std::shared_ptr<const CachedResponse> value;
+		std::size_t size;
+		Clock::time_point expires;
+		bool referenced;
+	};
+
+	struct Shard
+	{
+		mutable std::mutex mutex;
+		std::unordered_map<std::string, std::size_t> index;
+		std::vector<Entry> entries;
+		std::size_t hand = 0;
+		std::size_t memory_usage = 0;
+	};
+
+	Shard& get_shard(const std::string& key)
+	{
+		return _shards[std::hash<std::string>{}(key) % _shards.size()];
+	}
+
+	// Entries are kept in a vector so the removed entry is replaced by the last one
+	static void remove(Shard& shard, std::size_t position)
+	{
+		shard.memory_usage -= shard.entries[position].size;
+		shard.index.erase(shard.entries[position].key);
+		if (position != shard.entries.size() - 1)
+		{
+			shard.entries[position] = std::move(shard.entries.back());
+			shard.index[shard.entries[position].key] = position;
+		}
+		shard.entries.pop_back();
+	}
+
+	// Hand goes around the entries and gives every entry which was looked up since the last round a second chance
+	static void evict(Shard& shard)
+	{
+		while (true)
+		{
+			if (shard.hand >= shard.entries.size())
+				shard.hand = 0;
+
+			auto& entry = shard.entries[shard.hand];
+			if (!entry.referenced)
+			{
+				remove(shard, shard.hand);
+				return;
+			}
+
+			entry.referenced = false;
+			++shard.hand;
+		}
+	}
+
+	std::size_t _shard_budget;
+	std::vector<Shard> _shards;
+};
+
+} // namespace ulocal
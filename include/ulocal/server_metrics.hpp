@@ -0,0 +1,410 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <ulocal/http_response.hpp>
+#include <ulocal/utils.hpp>
+
+namespace ulocal {
+
+namespace detail {
+
+constexpr std::size_t MetricsShardCount = 4;
+
+inline std::size_t current_metrics_shard()
+{
+	static std::atomic<std::size_t> next_shard = 0;
+	thread_local std::size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % MetricsShardCount;
+	return shard;
+}
+
+constexpr std::size_t KnownStatusCodeCount = std::size(status_lines);
+
+constexpr auto status_code_index_table = [] {
+	std::array<std::uint8_t, MaxStatusCode + 1> result = {};
+	for (auto& index : result)
+		index = KnownStatusCodeCount;
+	for (std::size_t i = 0; i < KnownStatusCodeCount; ++i)
+	{
+		auto line = status_lines[i];
+		result[(line[9] - '0') * 100 + (line[10] - '0') * 10 + (line[11] - '0')] = static_cast<std::uint8_t>(i);
+	}
+	return result;
+}();
+
+constexpr std::size_t status_code_index(int status_code)
+{
+	return status_code < 0 || status_code > MaxStatusCode ? KnownStatusCodeCount : status_code_index_table[status_code];
+}
+
+constexpr int status_code_from_index(std::size_t index)
+{
+	auto line = status_lines[index];
+	return (line[9] - '0') * 100 + (line[10] - '0') * 10 + (line[11] - '0');
+}
+
+inline std::uint64_t elapsed_ns(std::chrono::steady_clock::time_point since)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+inline std::string escape_label(std::string_view value)
+{
+	std::string result;
+	result.reserve(value.length());
+	for (auto c : value)
+	{
+		if (c == '\\' || c == '"')
+			result += '\\';
+		if (c == '\n')
+			result.append("\\n");
+		else
+			result += c;
+	}
+	return result;
+}
+
+} // namespace detail
+
+template <std::size_t N>
+class ShardedCounters
+{
+public:
+	ShardedCounters() : _shards()
+	{
+		for (auto& shard : _shards)
+			for (auto& counter : shard.counters)
+				counter.store(0, std::memory_order_relaxed);
+	}
+
+	void add(std::size_t index, std::uint64_t value = 1)
+	{
+		_shards[detail::current_metrics_shard()].counters[index].fetch_add(value, std::memory_order_relaxed);
+	}
+
+	std::uint64_t load(std::size_t index) const
+	{
+		std::uint64_t result = 0;
+		for (const auto& shard : _shards)
+			result += shard.counters[index].load(std::memory_order_relaxed);
+		return result;
+	}
+
+private:
+	struct alignas(64) Shard
+	{
+		std::array<std::atomic<std::uint64_t>, N> counters;
+	};
+
+	std::array<Shard, detail::MetricsShardCount> _shards;
+};
+
+struct HistogramSnapshot
+{
+	std::uint64_t count = 0;
+	std::uint64_t sum_ns = 0;
+	// Pairs of inclusive upper bound of the bucket in nanoseconds and number of values in it, only non-empty buckets are present
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> buckets;
+
+	std::uint64_t percentile(double p) const
+	{
+		if (count == 0)
+			return 0;
+
+		auto rank = static_cast<std::uint64_t>(p * count);
+		std::uint64_t seen = 0;
+		for (const auto& [upper_bound, bucket_count] : buckets)
+		{
+			seen += bucket_count;
+			if (seen > rank)
+				return upper_bound;
+		}
+		return buckets.back().first;
+	}
+
+	std::uint64_t count_up_to(std::uint64_t value_ns) const
+	{
+		std::uint64_t result = 0;
+		for (const auto& [upper_bound, bucket_count] : buckets)
+		{
+			if (upper_bound > value_ns)
+				break;
+			result += bucket_count;
+		}
+		return result;
+	}
+};
+
+// Log-linear histogram of durations in nanoseconds with 8 sub-buckets per power of two (at most 12.5% relative error)
+class LatencyHistogram
+{
+public:
+	static constexpr std::size_t SubBucketBits = 3;
+	static constexpr std::size_t SubBucketCount = 1 << SubBucketBits;
+	static constexpr std::size_t BucketCount = (64 - SubBucketBits + 1) * SubBucketCount;
+
+	void record(std::uint64_t value_ns)
+	{
+		_counters.add(bucket_index(value_ns));
+		_counters.add(BucketCount, value_ns);
+	}
+
+	HistogramSnapshot snapshot() const
+	{
+		HistogramSnapshot result;
+		for (std::size_t i = 0; i < BucketCount; ++i)
+		{
+			if (auto count = _counters.load(i); count > 0)
+			{
+				result.buckets.emplace_back(bucket_upper_bound(i), count);
+				result.count += count;
+			}
+		}
+		result.sum_ns = _counters.load(BucketCount);
+		return result;
+	}
+
+	static constexpr std::size_t bucket_index(std::uint64_t value)
+	{
+		if (value < SubBucketCount)
+			return static_cast<std::size_t>(value);
+
+		std::size_t exponent = 63 - __builtin_clzll(value);
+		auto sub_bucket = (value >> (exponent - SubBucketBits)) & (SubBucketCount - 1);
+		return (exponent - SubBucketBits + 1) * SubBucketCount + sub_bucket;
+	}
+
+	static constexpr std::uint64_t bucket_upper_bound(std::size_t index)
+	{
+		if (index < SubBucketCount)
+			return index;
+
+		auto exponent = index / SubBucketCount + SubBucketBits - 1;
+		auto sub_bucket = index % SubBucketCount;
+		auto lower_bound = (std::uint64_t{1} << exponent) | (sub_bucket << (exponent - SubBucketBits));
+		return lower_bound + (std::uint64_t{1} << (exponent - SubBucketBits)) - 1;
+	}
+
+private:
+	// Last counter holds sum of all recorded values
+	ShardedCounters<BucketCount + 1> _counters;
+};
+
+class RouteMetrics
+{
+public:
+	void record_response(int status_code)
+	{
+		_responses.add(detail::status_code_index(status_code));
+	}
+
+	void record_handler_time(std::uint64_t duration_ns)
+	{
+		_handler_time.record(duration_ns);
+	}
+
+	std::vector<std::pair<int, std::uint64_t>> get_responses() const
+	{
+		std::vector<std::pair<int, std::uint64_t>> result;
+		for (std::size_t i = 0; i < detail::KnownStatusCodeCount; ++i)
+		{
+			if (auto count = _responses.load(i); count > 0)
+				result.emplace_back(detail::status_code_from_index(i), count);
+		}
+		// Status codes which are not in the status line table are all reported as 0
+		if (auto count = _responses.load(detail::KnownStatusCodeCount); count > 0)
+			result.emplace_back(0, count);
+		return result;
+	}
+
+	HistogramSnapshot get_handler_time() const { return _handler_time.snapshot(); }
+
+private:
+	ShardedCounters<detail::KnownStatusCodeCount + 1> _responses;
+	LatencyHistogram _handler_time;
+};
+
+struct RouteMetricsSnapshot
+{
+	// Requests which didn't match any route are reported under this name so they don't clash with the series without route label
+	static constexpr std::string_view UnmatchedRoute = "<unmatched>";
+
+	std::string route;
+	std::vector<std::pair<int, std::uint64_t>> responses;
+	HistogramSnapshot handler_time;
+};
+
+struct MetricsSnapshot
+{
+	std::uint64_t accepted_connections = 0;
+	std::uint64_t closed_connections = 0;
+	std::uint64_t timed_out_connections = 0;
+	std::uint64_t rejected_connections = 0;
+	std::uint64_t unauthorized_connections = 0;
+	std::uint64_t active_connections = 0;
+	std::uint64_t bytes_in = 0;
+	std::uint64_t bytes_out = 0;
+	std::uint64_t parse_errors = 0;
+	std::uint64_t coalesced_requests = 0;
+	std::uint64_t cache_hits = 0;
+	std::uint64_t cache_misses = 0;
+	HistogramSnapshot parse_time;
+	HistogramSnapshot handler_time;
+	HistogramSnapshot write_time;
+	std::vector<RouteMetricsSnapshot> routes;
+
+	std::string to_prometheus() const
+	{
+		std::ostringstream ss;
+		auto counter = [&](std::string_view name, std::string_view help, std::string_view type, std::uint64_t value) {
+			ss << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n' << name << ' ' << value << '\n';
+		};
+
+		counter("ulocal_connections_accepted_total", "Number of accepted connections.", "counter", accepted_connections);
+		counter("ulocal_connections_closed_total", "Number of closed connections.", "counter", closed_connections);
+		counter("ulocal_connections_timed_out_total", "Number of connections closed because of a timeout.", "counter", timed_out_connections);
+		counter("ulocal_connections_rejected_total", "Number of connections rejected because the server was overloaded.", "counter", rejected_connections);
+		counter("ulocal_connections_unauthorized_total", "Number of connections rejected because the peer was not allowed.", "counter", unauthorized_connections);
+		counter("ulocal_connections_active", "Number of currently open connections.", "gauge", active_connections);
+		counter("ulocal_received_bytes_total", "Number of bytes received from clients.", "counter", bytes_in);
+		counter("ulocal_sent_bytes_total", "Number of bytes sent to clients.", "counter", bytes_out);
+		counter("ulocal_parse_errors_total", "Number of requests which could not be parsed.", "counter", parse_errors);
+		counter("ulocal_requests_coalesced_total", "Number of requests answered by the response of identical request without calling the handler.", "counter", coalesced_requests);
+		counter("ulocal_cache_hits_total", "Number of requests answered from the response cache.", "counter", cache_hits);
+		counter("ulocal_cache_misses_total", "Number of requests of cached routes which were not found in the response cache.", "counter", cache_misses);
+
+		ss << "# HELP ulocal_requests_total Number of responses per route and status code.\n"
+			<< "# TYPE ulocal_requests_total counter\n";
+		for (const auto& route : routes)
+			for (const auto& [status_code, count] : route.responses)
+				ss << "ulocal_requests_total{route=\"" << detail::escape_label(route.route) << "\",code=\"" << status_code << "\"} " << count << '\n';
+
+		histogram(ss, "ulocal_parse_duration_seconds", "Time spent parsing requests.", {}, parse_time, true);
+		histogram(ss, "ulocal_write_duration_seconds", "Time spent writing responses.", {}, write_time, true);
+		histogram(ss, "ulocal_handler_duration_seconds", "Time spent in request handlers.", {}, handler_time, true);
+		for (const auto& route : routes)
+			histogram(ss, "ulocal_route_handler_duration_seconds", "Time spent in request handlers per route.", route.route, route.handler_time, &route == &routes.front());
+
+		return ss.str();
+	}
+
+private:
+	static void histogram(std::ostringstream& ss, std::string_view name, std::string_view help, std::string_view route, const HistogramSnapshot& snapshot, bool with_header)
+	{
+		static constexpr std::array<std::uint64_t, 14> bounds_ns = {
+			10'000, 50'000, 100'000, 250'000, 500'000,
+			1'000'000, 2'500'000, 5'000'000, 10'000'000, 25'000'000,
+			50'000'000, 100'000'000, 1'000'000'000, 10'000'000'000
+		};
+
+		if (with_header)
+			ss << "# HELP " << name << ' ' << help << "\n# TYPE " << name << " histogram\n";
+
+		std::string labels = route.empty() ? std::string{} : "route=\"" + detail::escape_label(route) + "\",";
+		for (auto bound : bounds_ns)
+			ss << name << "_bucket{" << labels << "le=\"" << bound / 1e9 << "\"} " << snapshot.count_up_to(bound) << '\n';
+		ss << name << "_bucket{" << labels << "le=\"+Inf\"} " << snapshot.count << '\n';
+
+		if (!labels.empty())
+			labels = '{' + labels.substr(0, labels.length() - 1) + '}';
+		ss << name << "_sum" << labels << ' ' << snapshot.sum_ns / 1e9 << '\n';
+		ss << name << "_count" << labels << ' ' << snapshot.count << '\n';
+	}
+};
+
+class ServerMetrics
+{
+public:
+	enum Counter : std::size_t
+	{
+		AcceptedConnections,
+		ClosedConnections,
+		TimedOutConnections,
+		RejectedConnections,
+		UnauthorizedConnections,
+		BytesIn,
+		BytesOut,
+		ParseErrors,
+		CoalescedRequests,
+		CacheHits,
+		CacheMisses,
+		CounterCount
+	};
+
+	void add(Counter counter, std::uint64_t value = 1) { _counters.add(counter, value); }
+
+	void record_parse_time(std::uint64_t duration_ns) { _parse_time.record(duration_ns); }
+	void record_handler_time(std::uint64_t duration_ns) { _handler_time.record(duration_ns); }
+	void record_write_time(std::uint64_t duration_ns) { _write_time.record(duration_ns); }
+
+	RouteMetrics* register_route(const std::string& route)
+	{
+		std::lock_guard<std::mutex> lock(_routes_mutex);
+		auto itr = _routes.find(route);
+		if (itr == _routes.end())
+			itr = _routes.emplace(route, std::make_unique<RouteMetrics>()).first;
+		return itr->second.get();
+	}
+
+	// Routes are only registered from the thread which serves requests or before serving starts so lookup doesn't need to lock
+	RouteMetrics* find_route(const std::string& route)
+	{
+		auto itr = _routes.find(route);
+		return itr == _routes.end() ? &_unmatched : itr->second.get();
+	}
+
+	MetricsSnapshot snapshot() const
+	{
+		MetricsSnapshot result;
+		result.accepted_connections = _counters.load(AcceptedConnections);
+		result.closed_connections = _counters.load(ClosedConnections);
+		result.timed_out_connections = _counters.load(TimedOutConnections);
+		result.rejected_connections = _counters.load(RejectedConnections);
+		result.unauthorized_connections = _counters.load(UnauthorizedConnections);
+		result.active_connections = result.accepted_connections - std::min(result.accepted_connections, result.closed_connections);
+		result.bytes_in = _counters.load(BytesIn);
+		result.bytes_out = _counters.load(BytesOut);
+		result.parse_errors = _counters.load(ParseErrors);
+		result.coalesced_requests = _counters.load(CoalescedRequests);
+		result.cache_hits = _counters.load(CacheHits);
+		result.cache_misses = _counters.load(CacheMisses);
+		result.parse_time = _parse_time.snapshot();
+		result.handler_time = _handler_time.snapshot();
+		result.write_time = _write_time.snapshot();
+
+		std::lock_guard<std::mutex> lock(_routes_mutex);
+		for (const auto& [route, metrics] : _routes)
+			result.routes.push_back({route, metrics->get_responses(), metrics->get_handler_time()});
+		std::sort(result.routes.begin(), result.routes.end(), [](const auto& lhs, const auto& rhs) {
+			return lhs.route < rhs.route;
+		});
+		if (auto responses = _unmatched.get_responses(); !responses.empty())
+			result.routes.push_back({std::string{RouteMetricsSnapshot::UnmatchedRoute}, std::move(responses), _unmatched.get_handler_time()});
+
+		return result;
+	}
+
+private:
+	ShardedCounters<CounterCount> _counters;
+	LatencyHistogram _parse_time;
+	LatencyHistogram _handler_time;
+	LatencyHistogram _write_time;
+
+	mutable std::mutex _routes_mutex;
+	std::unordered_map<std::string, std::unique_ptr<RouteMetrics>, CaseInsensitiveHash, CaseInsensitiveCompare> _routes;
+	RouteMetrics _unmatched;
+};
+
+} // namespace ulocal
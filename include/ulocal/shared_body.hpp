@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cerrno>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <ulocal/file_descriptor.hpp>
+#include <ulocal/http_message.hpp>
+#include <ulocal/key_value.hpp>
+#include <ulocal/utils.hpp>
+
+namespace ulocal {
+
+// Request header by which the client announces that it accepts responses with shared body
+constexpr std::string_view AcceptSharedBodyHeader = "X-Accept-Shared-Body";
+// Reference to the content kept in shared memory passed with the message, "<fd index> <offset> <length>"
+constexpr std::string_view SharedBodyHeader = "X-Shared-Body";
+
+namespace detail {
+
+inline std::optional<std::size_t> next_number(std::string_view& str)
+{
+	str = strip(str);
+	auto end = str.find(' ');
+	auto result = ValueGetter<std::size_t>::convert(str.substr(0, end));
+	str = end == std::string_view::npos ? std::string_view{} : str.substr(end);
+	return result;
+}
+
+} // namespace detail
+
+// Moves the content of the message into sealed memfd which is passed together with the message so large
+// bodies never go through the socket buffer. Returns false and leaves the message untouched if it can't
+// be shared, the message then has to be sent with the content inline.
+inline bool share_body(HttpMessage& message)
+{
+	const auto& content = message.get_content();
+	if (content.empty() || message.has_header(HttpHeaderId::ContentLength) || message.has_header(SharedBodyHeader))
+		return false;
+
+	FileDescriptor fd{::memfd_create("ulocal-body", MFD_CLOEXEC | MFD_ALLOW_SEALING)};
+	if (!fd)
+		return false;
+
+	for (std::size_t written = 0; written < content.length();)
+	{
+		auto n = ::write(fd.get(), content.data() + written, content.length() - written);
+		if (n < 0 && errno != EINTR)
+			return false;
+		else if (n > 0)
+			written += static_cast<std::size_t>(n);
+	}
+
+	// Receiver can then read it without worrying that it changes or shrinks under its hands
+	if (::fcntl(fd.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0)
+		return false;
+
+	std::string reference;
+	append_number(reference, message.get_fds().size());
+	reference.append(" 0 ");
+	append_number(reference, content.length());
+
+	message.add_header(SharedBodyHeader, std::move(reference));
+	message.add_fd(std::move(fd));
+	message.set_content({});
+	return true;
+}
+
+// Replaces the reference to the shared memory in received message by the content itself. Shared body is only accepted
+// in sealed memfd which the sender can't change anymore and which can't block the reader, and only up to max_length
+// bytes. Zero max_length means the receiver doesn't accept shared bodies at all.
+inline void unshare_body(HttpMessage& message, std::size_t max_length = std::numeric_limits<std::size_t>::max())
+{
+	auto header = message.get_header(SharedBodyHeader);
+	if (!header)
+		return;
+	else if (max_length == 0)
+		throw ParseError("Shared body is not accepted");
+
+	std::string_view value = header->get_value();
+	auto index = detail::next_number(value);
+	auto offset = detail::next_number(value);
+	auto length = detail::next_number(value);
+	if (!index || !offset || !length || !strip(value).empty() || index.value() >= message.get_fds().size() || !message.get_content().empty())
+		throw ParseError("Invalid shared body reference");
+
+	else if (length.value() > max_length)
+		throw ParseError("Shared body is too large");
+
+	auto fd = message.get_fds()[index.value()].get();
+	struct stat file_stat;
+	if (::fstat(fd, &file_stat) < 0 || !S_ISREG(file_stat.st_mode))
+		throw ParseError("Shared body is not a regular file");
+
+	// Only memfd supports seals, so this also rules out files on slow or remote filesystems
+	auto seals = ::fcntl(fd, F_GET_SEALS);
+	if (seals < 0 || (seals & (F_SEAL_SHRINK | F_SEAL_WRITE)) != (F_SEAL_SHRINK | F_SEAL_WRITE))
+		throw ParseError("Shared body is not sealed");
+
+	if (offset.value() > static_cast<std::size_t>(file_stat.st_size) || length.value() > static_cast<std::size_t>(file_stat.st_size) - offset.value())
+		throw ParseError("Shared body is shorter than announced");
+
+	std::string content(length.value(), '\0');
+	for (std::size_t read = 0; read < content.length();)
+	{
+		auto n = ::pread(fd, content.data() + read, content.length() - read, offset.value() + read);
+		if (n < 0 && errno == EINTR)
+			continue;
+		else if (n <= 0)
+			throw ParseError("Shared body is shorter than announced");
+		read += static_cast<std::size_t>(n);
+	}
+
+	auto fds = message.release_fds();
+	for (std::size_t i = 0; i < fds.size(); ++i)
+	{
+		if (i != index.value())
+			message.add_fd(std::move(fds[i]));
+	}
+
+	message.remove_header(SharedBodyHeader);
+	message.remove_header(get_header_name(HttpHeaderId::ContentLength));
+	message.set_content(std::move(content));
+	message.calculate_content_length();
+}
+
+} // namespace ulocal
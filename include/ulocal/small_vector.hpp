@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ulocal {
+
+template <typename T, std::size_t N>
+class SmallVector
+{
+public:
+	using value_type = T;
+	using iterator = T*;
+	using const_iterator = const T*;
+
+	SmallVector() : _data(inline_data()), _size(0), _capacity(N) {}
+
+	SmallVector(const SmallVector& rhs) : SmallVector()
+	{
+		reserve(rhs._size);
+		std::uninitialized_copy(rhs.begin(), rhs.end(), _data);
+		_size = rhs._size;
+	}
+
+	SmallVector(SmallVector&& rhs) noexcept : SmallVector()
+	{
+		take(std::move(rhs));
+	}
+
+	~SmallVector()
+	{
+		clear();
+		deallocate();
+	}
+
+	SmallVector& operator=(const SmallVector& rhs)
+	{
+		if (this != &rhs)
+		{
+			clear();
+			reserve(rhs._size);
+			std::uninitialized_copy(rhs.begin(), rhs.end(), _data);
+			_size = rhs._size;
+		}
+		return *this;
+	}
+
+	SmallVector& operator=(SmallVector&& rhs) noexcept
+	{
+		if (this != &rhs)
+		{
+			clear();
+			deallocate();
+			take(std::move(rhs));
+		}
+		return *this;
+	}
+
+	iterator begin() { return _data; }
+	iterator end() { return _data + _size; }
+	const_iterator begin() const { return _data; }
+	const_iterator end() const { return _data + _size; }
+
+	T& operator[](std::size_t index) { return _data[index]; }
+	const T& operator[](std::size_t index) const { return _data[index]; }
+
+	T& back() { return _data[_size - 1]; }
+	const T& back() const { return _data[_size - 1]; }
+
+	std::size_t size() const { return _size; }
+	std::size_t capacity() const { return _capacity; }
+	bool empty() const { return _size == 0; }
+	bool is_inline() const { return _data == inline_data(); }
+
+	void reserve(std::size_t capacity)
+	{
+		if (capacity > _capacity)
+			reallocate(capacity, nullptr);
+	}
+
+	template <typename... Args>
+	T& emplace_back(Args&&... args)
+	{
+		if (_size == _capacity)
+		{
+			// Construct the new element first as arguments may refer to the elements we are about to move
+			reallocate(2 * _capacity, [&](T* where) { new (where) T(std::forward<Args>(args)...); });
+		}
+		else
+			new (_data + _size) T(std::forward<Args>(args)...);
+
+		return _data[_size++];
+	}
+
+	void push_back(const T& value) { emplace_back(value); }
+	void push_back(T&& value) { emplace_back(std::move(value)); }
+
+	iterator erase(iterator pos)
+	{
+		std::move(pos + 1, end(), pos);
+		std::destroy_at(end() - 1);
+		--_size;
+		return pos;
+	}
+
+	void clear()
+	{
+		std::destroy(begin(), end());
+		_size = 0;
+	}
+
+private:
+	T* inline_data() { return reinterpret_cast<T*>(_storage); }
+	const T* inline_data() const { return reinterpret_cast<const T*>(_storage); }
+
+	template <typename Construct>
+	void reallocate(std::size_t capacity, Construct&& construct_last)
+	{
+		auto* new_data = static_cast<T*>(::operator new(capacity * sizeof(T)));
+		if constexpr (!std::is_same_v<std::decay_t<Construct>, std::nullptr_t>)
+		{
+			try
+			{
+				construct_last(new_data + _size);
+			}
+			catch (...)
+			{
+				::operator delete(new_data);
+				throw;
+			}
+		}
+
+		std::uninitialized_move(begin(), end(), new_data);
+		std::destroy(begin(), end());
+		deallocate();
+
+		_data = new_data;
+		_capacity = capacity;
+	}
+
+	void deallocate()
+	{
+		if (!is_inline())
+			::operator delete(_data);
+		_data = inline_data();
+		_capacity = N;
+	}
+
+	void take(SmallVector&& rhs)
+	{
+		if (rhs.is_inline())
+		{
+			std::uninitialized_move(rhs.begin(), rhs.end(), _data);
+			_size = rhs._size;
+			rhs.clear();
+		}
+		else
+		{
+			_data = rhs._data;
+			_size = rhs._size;
+			_capacity = rhs._capacity;
+			rhs._data = rhs.inline_data();
+			rhs._size = 0;
+			rhs._capacity = N;
+		}
+	}
+
+	T* _data;
+	std::size_t _size;
+	std::size_t _capacity;
+	alignas(T) unsigned char _storage[N * sizeof(T)];
+};
+
+} // namespace ulocal
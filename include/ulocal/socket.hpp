@@ -1,6 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include <fcntl.h>
 #include <poll.h>
@@ -9,26 +17,96 @@
 #include <sys/un.h>
 #include <unistd.h>
 
+#include <ulocal/file_descriptor.hpp>
+#include <ulocal/peer_credentials.hpp>
 #include <ulocal/string_stream.hpp>
 
 namespace ulocal {
 
 struct Network
 {
-	static ssize_t read(int fd, void* buf, size_t len)
+	// Number of file descriptors which can be received with a single read
+	static constexpr std::size_t MaxFdsPerRead = 64;
+
+	// File descriptors passed by the peer (SCM_RIGHTS) are appended to fds
+	static ssize_t read(int fd, void* buf, size_t len, std::vector<FileDescriptor>& fds)
 	{
-		return ::recv(fd, buf, len, 0);
+		iovec iov = {buf, len};
+		alignas(cmsghdr) char control[CMSG_SPACE(MaxFdsPerRead * sizeof(int))];
+
+		msghdr msg;
+		std::memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		auto n = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+		if (n < 0)
+			return n;
+
+		for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+				continue;
+
+			auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				int received;
+				std::memcpy(&received, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+				fds.emplace_back(received);
+			}
+		}
+
+		// Descriptors which didn't fit are closed by the kernel and the data they belong to can't be trusted
+		if (msg.msg_flags & MSG_CTRUNC)
+		{
+			errno = EMSGSIZE;
+			return -1;
+		}
+
+		return n;
 	}
 
 	static ssize_t write(int fd, const void* buf, size_t len)
 	{
-		return ::send(fd, buf, len, 0);
+		return ::send(fd, buf, len, MSG_NOSIGNAL);
+	}
+
+	// File descriptors are attached to the first byte written
+	static ssize_t write(int fd, const void* buf, size_t len, const std::vector<FileDescriptor>& fds)
+	{
+		if (fds.empty())
+			return write(fd, buf, len);
+
+		iovec iov = {const_cast<void*>(buf), len};
+		std::vector<char> control(CMSG_SPACE(fds.size() * sizeof(int)));
+
+		msghdr msg;
+		std::memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control.data();
+		msg.msg_controllen = control.size();
+
+		auto cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+		for (std::size_t i = 0; i < fds.size(); ++i)
+		{
+			int fd_to_send = fds[i].get();
+			std::memcpy(CMSG_DATA(cmsg) + i * sizeof(int), &fd_to_send, sizeof(int));
+		}
+
+		return ::sendmsg(fd, &msg, MSG_NOSIGNAL);
 	}
 };
 
 struct NonNetwork
 {
-	static ssize_t read(int fd, void* buf, size_t len)
+	static ssize_t read(int fd, void* buf, size_t len, std::vector<FileDescriptor>&)
 	{
 		return ::read(fd, buf, len);
 	}
@@ -37,6 +115,16 @@ struct NonNetwork
 	{
 		return ::write(fd, buf, len);
 	}
+
+	static ssize_t write(int fd, const void* buf, size_t len, const std::vector<FileDescriptor>& fds)
+	{
+		if (!fds.empty())
+		{
+			errno = ENOTSOCK;
+			return -1;
+		}
+		return write(fd, buf, len);
+	}
 };
 
 class SocketError : public std::exception
@@ -50,44 +138,78 @@ private:
 	const char* _msg;
 };
 
+// Process or system ran out of descriptors or memory, connections waiting in the backlog can be accepted
+// once some of them are released
+class SocketLimitError : public SocketError
+{
+public:
+	using SocketError::SocketError;
+};
+
 template <typename SocketOp = Network>
 class Socket
 {
 public:
-	Socket() : Socket(::socket(AF_UNIX, SOCK_STREAM, 0)) {}
+	Socket() : Socket(::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0), false) {}
 
-	Socket(int fd) : _fd(fd), _stream(4096)
-	{
-		if (_fd < 0)
-			throw SocketError("Unable to create socket");
-
-		if (::fcntl(_fd, F_SETFL, O_NONBLOCK) < 0)
-			throw SocketError("Unable to switch socket to non-blocking mode");
-	}
+	// Takes ownership of existing file descriptor and switches it to non-blocking mode
+	Socket(int fd) : Socket(fd, true) {}
 
 	~Socket()
 	{
 		close();
 	}
 
-	Socket(Socket&& rhs) noexcept : _fd(rhs._fd), _stream(std::move(rhs._stream))
+	Socket(Socket&& rhs) noexcept : _fd(rhs._fd), _stream(std::move(rhs._stream)), _received_fds(std::move(rhs._received_fds)), _listening(rhs._listening)
 	{
 		rhs._fd = 0;
+		rhs._listening = false;
 	}
 
 	Socket& operator=(Socket&& rhs) noexcept
 	{
-		_fd = rhs._fd;
-		_stream = std::move(rhs._stream);
-		rhs._fd = 0;
+		if (this != &rhs)
+		{
+			close();
+			_fd = rhs._fd;
+			_stream = std::move(rhs._stream);
+			_received_fds = std::move(rhs._received_fds);
+			_listening = rhs._listening;
+			rhs._fd = 0;
+			rhs._listening = false;
+		}
 		return *this;
 	}
 
+	// Takes ownership of socket which is already bound and listening, e.g. inherited from the service manager
+	// or received from another process. Nothing is taken over if the descriptor is not a listening stream socket.
+	static Socket from_listening_fd(int fd)
+	{
+		if (!is_listening_stream(fd))
+			throw SocketError("File descriptor is not a listening stream socket");
+
+		if (::fcntl(fd, F_SETFD, FD_CLOEXEC) < 0)
+			throw SocketError("Unable to set close-on-exec flag of the socket");
+
+		Socket result{fd, true};
+		result._listening = true;
+		return result;
+	}
+
+	static bool is_listening_stream(int fd)
+	{
+		int type, listening;
+		socklen_t type_len = sizeof(type), listening_len = sizeof(listening);
+		return ::getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &type_len) == 0 && type == SOCK_STREAM
+			&& ::getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &listening_len) == 0 && listening > 0;
+	}
+
 	Socket(const Socket&) = delete;
 	Socket& operator=(const Socket&) = delete;
 
 	int get_fd() const { return _fd; }
 	StringStream& get_stream() { return _stream; }
+	const StringStream& get_stream() const { return _stream; }
 	pollfd get_poll_fd() const { return {_fd, POLLIN, 0}; }
 
 	bool is_closed() const { return _fd == 0; }
@@ -101,58 +223,88 @@ public:
 		return result > 0;
 	}
 
+	std::optional<PeerCredentials> get_peer_credentials() const
+	{
+		ucred credentials;
+		socklen_t len = sizeof(credentials);
+		if (::getsockopt(_fd, SOL_SOCKET, SO_PEERCRED, &credentials, &len) == -1 || len != sizeof(credentials))
+			return std::nullopt;
+		return PeerCredentials{credentials.pid, credentials.uid, credentials.gid};
+	}
+
+	// Paths starting with '@' or null character are names in the Linux abstract namespace which don't
+	// create any file and disappear once the socket is closed
 	void connect(const std::string& file_path)
 	{
-		auto sa = create_sockaddr(file_path);
-		if (::connect(_fd, reinterpret_cast<sockaddr*>(&sa), SUN_LEN(&sa)) < 0)
+		socklen_t len;
+		auto sa = create_sockaddr(file_path, len);
+		if (::connect(_fd, reinterpret_cast<sockaddr*>(&sa), len) < 0)
 			throw SocketError("Error while connecting to the local socket");
 	}
 
-	void listen(const std::string& file_path)
+	void listen(const std::string& file_path, int backlog = 16)
 	{
-		auto sa = create_sockaddr(file_path);
-		if (::bind(_fd, reinterpret_cast<sockaddr*>(&sa), SUN_LEN(&sa)) < 0)
+		socklen_t len;
+		auto sa = create_sockaddr(file_path, len);
+		if (::bind(_fd, reinterpret_cast<sockaddr*>(&sa), len) < 0)
 			throw SocketError("Unable to bind the local socket");
 
-		if (::listen(_fd, 16) < 0)
+		if (::listen(_fd, backlog) < 0)
 			throw SocketError("Unable to start listening to the local socket");
+		_listening = true;
 	}
 
 	std::optional<Socket> accept_connection()
 	{
-		auto client_fd = ::accept(_fd, nullptr, nullptr);
+		int client_fd;
+		do
+		{
+			client_fd = ::accept4(_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		}
+		while (client_fd < 0 && (errno == EINTR || errno == ECONNABORTED));
+
 		if (client_fd < 0)
 		{
 			if (errno == EWOULDBLOCK)
 				return std::nullopt;
+			else if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+				throw SocketLimitError("Not enough resources to accept new connection on the local socket");
 
 			throw SocketError("Error while accepting new connection on the local socket");
 		}
 
-		return client_fd;
+		return Socket{client_fd, false};
 	}
 
-	void read()
+	// Returns false once the other side closed the connection and there is nothing more to read
+	bool read()
 	{
-		int n = 0;
-
-		do
+		while (_stream.get_writable_size() > 0)
 		{
-			n = SocketOp::read(_fd, _stream.get_writable_buffer(), _stream.get_writable_size());
+			auto n = SocketOp::read(_fd, _stream.get_writable_buffer(), _stream.get_writable_size(), _received_fds);
 			if (n < 0)
 			{
 				if (errno == EWOULDBLOCK)
-					return;
+					return true;
+				// Peer closed the connection without reading everything we sent, what it sent before is still valid
+				else if (errno == ECONNRESET)
+					return false;
 
 				throw SocketError("Error while reading data from the local socket");
 			}
+			else if (n == 0)
+				return false;
+
+			if (_received_fds.size() > MaxReceivedFds)
+				throw SocketError("Too many file descriptors received on the local socket");
 
 			_stream.increase_used(n);
 		}
-		while (n > 0);
+
+		return true;
 	}
 
-	void write(const std::string& str)
+	std::size_t write(std::string_view str)
 	{
 		std::size_t sent = 0;
 		while (sent < str.length())
@@ -161,39 +313,107 @@ public:
 			if (n < 0)
 			{
 				if (errno == EWOULDBLOCK)
-					return;
+					return sent;
 
 				throw SocketError("Error while writing data to the local socket");
 			}
 
 			sent += static_cast<std::size_t>(n);
 		}
+
+		return sent;
+	}
+
+	// File descriptors are sent together with the first byte so they are not sent at all if nothing could be written
+	std::size_t write(std::string_view str, const std::vector<FileDescriptor>& fds)
+	{
+		if (fds.empty() || str.empty())
+			return write(str);
+
+		ssize_t n;
+		do
+		{
+			n = SocketOp::write(_fd, str.data(), str.length(), fds);
+		}
+		while (n < 0 && errno == EINTR);
+
+		if (n < 0)
+		{
+			if (errno == EWOULDBLOCK)
+				return 0;
+
+			throw SocketError("Error while writing data to the local socket");
+		}
+
+		return static_cast<std::size_t>(n) + write(str.substr(n));
+	}
+
+	// File descriptors received so far which were not taken yet, in the order in which they were sent
+	std::size_t get_received_fd_count() const { return _received_fds.size(); }
+
+	std::vector<FileDescriptor> take_received_fds(std::size_t count)
+	{
+		count = std::min(count, _received_fds.size());
+		std::vector<FileDescriptor> result(std::make_move_iterator(_received_fds.begin()), std::make_move_iterator(_received_fds.begin() + count));
+		_received_fds.erase(_received_fds.begin(), _received_fds.begin() + count);
+		return result;
 	}
 
 	void close()
 	{
 		if (_fd != 0)
 		{
-			::shutdown(_fd, SHUT_RDWR);
+			// Listening socket may be shared with another process after handoff and shutting it down
+			// would make it refuse connections there as well
+			if (!_listening)
+				::shutdown(_fd, SHUT_RDWR);
 			::close(_fd);
 			_fd = 0;
+			_listening = false;
+			_received_fds.clear();
 		}
 	}
 
 private:
-	sockaddr_un create_sockaddr(const std::string& file_path)
+	Socket(int fd, bool set_non_blocking) : _fd(fd), _stream(4096), _received_fds(), _listening(false)
+	{
+		if (_fd < 0)
+			throw SocketError("Unable to create socket");
+
+		if (set_non_blocking)
+		{
+			auto flags = ::fcntl(_fd, F_GETFL);
+			if (flags < 0 || (!(flags & O_NONBLOCK) && ::fcntl(_fd, F_SETFL, flags | O_NONBLOCK) < 0))
+				throw SocketError("Unable to switch socket to non-blocking mode");
+		}
+	}
+
+	static sockaddr_un create_sockaddr(const std::string& file_path, socklen_t& len)
 	{
 		sockaddr_un sa;
 		memset(&sa, 0, sizeof(sockaddr_un));
-
 		sa.sun_family = AF_UNIX;
-		std::strncpy(sa.sun_path, file_path.c_str(), std::min(file_path.length(), sizeof(sa.sun_path) - 1));
 
+		bool abstract = !file_path.empty() && (file_path[0] == '@' || file_path[0] == '\0');
+		// Abstract names are not null-terminated while filesystem paths need room for the terminator
+		if (file_path.empty() || file_path.length() > sizeof(sa.sun_path) - (abstract ? 0 : 1))
+			throw SocketError("Invalid length of the local socket path");
+
+		std::memcpy(sa.sun_path, file_path.data(), file_path.length());
+		if (abstract)
+			sa.sun_path[0] = '\0';
+
+		len = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + file_path.length() + (abstract ? 0 : 1));
 		return sa;
 	}
 
+	// Limit of file descriptors waiting to be taken so misbehaving peer can't exhaust them
+	static constexpr std::size_t MaxReceivedFds = 256;
+
 	int _fd;
 	StringStream _stream;
+	std::vector<FileDescriptor> _received_fds;
+	bool _listening;
 };
 
 } // namespace ulocal
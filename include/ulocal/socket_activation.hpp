@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <ulocal/socket.hpp>
+
+namespace ulocal {
+
+namespace detail {
+
+inline std::optional<long> get_env_number(const char* name)
+{
+	auto value = std::getenv(name);
+	if (!value || *value == '\0')
+		return std::nullopt;
+
+	char* end = nullptr;
+	errno = 0;
+	auto result = std::strtol(value, &end, 10);
+	if (errno != 0 || *end != '\0' || result < 0)
+		return std::nullopt;
+	return result;
+}
+
+inline void wait_for_socket(const Socket<>& socket, short events, std::chrono::milliseconds timeout)
+{
+	pollfd fd = {socket.get_fd(), events, 0};
+	int result;
+	do
+	{
+		result = ::poll(&fd, 1, static_cast<int>(timeout.count()));
+	}
+	while (result < 0 && errno == EINTR);
+
+	if (result == 0)
+		throw SocketError("Timed out while waiting for the socket handoff");
+	else if (result < 0 || (fd.revents & (POLLERR | POLLNVAL)))
+		throw SocketError("Error while waiting for the socket handoff");
+}
+
+} // namespace detail
+
+// First file descriptor passed by the service manager, see sd_listen_fds(3)
+constexpr int ListenFdsStart = 3;
+
+// Returns listening sockets passed through systemd-style socket activation (LISTEN_PID and LISTEN_FDS).
+// Passed descriptors which are not listening stream sockets are left untouched. Variables are removed
+// from the environment by default so they are not inherited by child processes.
+inline std::vector<Socket<>> get_activated_sockets(bool unset_environment = true)
+{
+	std::vector<Socket<>> result;
+
+	auto pid = detail::get_env_number("LISTEN_PID");
+	auto count = detail::get_env_number("LISTEN_FDS");
+	if (pid && count && pid.value() == ::getpid())
+	{
+		for (int fd = ListenFdsStart; fd < ListenFdsStart + count.value(); ++fd)
+		{
+			if (Socket<>::is_listening_stream(fd))
+				result.push_back(Socket<>::from_listening_fd(fd));
+		}
+	}
+
+	if (unset_environment)
+	{
+		::unsetenv("LISTEN_PID");
+		::unsetenv("LISTEN_FDS");
+		::unsetenv("LISTEN_FDNAMES");
+	}
+
+	return result;
+}
+
+// Passes listening socket to another process over connected local socket (SCM_RIGHTS). The socket stays
+// open in both processes and shares the same listen queue, so the old process can be drained afterwards
+// without refusing any connection.
+inline void send_listening_socket(const Socket<>& channel, const Socket<>& listening_socket, std::chrono::milliseconds timeout = std::chrono::seconds(5))
+{
+	char data = 0;
+	iovec iov = {&data, sizeof(data)};
+
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+	std::memset(control, 0, sizeof(control));
+
+	msghdr msg;
+	std::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	auto cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	int fd = listening_socket.get_fd();
+	std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+
+	while (::sendmsg(channel.get_fd(), &msg, MSG_NOSIGNAL) < 0)
+	{
+		if (errno == EWOULDBLOCK)
+			detail::wait_for_socket(channel, POLLOUT, timeout);
+		else if (errno != EINTR)
+			throw SocketError("Error while sending the listening socket");
+	}
+}
+
+// Receives listening socket sent by send_listening_socket() from another process
+inline Socket<> receive_listening_socket(const Socket<>& channel, std::chrono::milliseconds timeout = std::chrono::seconds(5))
+{
+	char data = 0;
+	iovec iov = {&data, sizeof(data)};
+
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+	std::memset(control, 0, sizeof(control));
+
+	msghdr msg;
+	std::memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	ssize_t n;
+	while ((n = ::recvmsg(channel.get_fd(), &msg, MSG_CMSG_CLOEXEC)) < 0)
+	{
+		if (errno == EWOULDBLOCK)
+			detail::wait_for_socket(channel, POLLIN, timeout);
+		else if (errno != EINTR)
+			throw SocketError("Error while receiving the listening socket");
+	}
+
+	int fd = -1;
+	auto cmsg = CMSG_FIRSTHDR(&msg);
+	if (n > 0 && cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS && cmsg->cmsg_len == CMSG_LEN(sizeof(int)))
+		std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+
+	if (fd < 0)
+		throw SocketError("No listening socket received");
+
+	try
+	{
+		return Socket<>::from_listening_fd(fd);
+	}
+	catch (const SocketError&)
+	{
+		::close(fd);
+		throw;
+	}
+}
+
+} // namespace ulocal
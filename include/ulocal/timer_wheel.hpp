@@ -0,0 +1,285 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace ulocal {
+
+// Hierarchical timing wheel with O(1) scheduling and cancellation. Timers are kept
+// in 4 levels of 64 slots where each level covers 64 times the range of the previous one.
+// Slots of upper levels are cascaded to the lower levels once the wheel reaches them.
+class TimerWheel
+{
+public:
+	using Clock = std::chrono::steady_clock;
+	using TimerId = std::uint32_t;
+
+	static constexpr TimerId InvalidTimer = ~TimerId{0};
+
+	TimerWheel(std::chrono::milliseconds resolution = std::chrono::milliseconds(10), Clock::time_point now = Clock::now())
+		: _resolution(std::max(resolution, std::chrono::milliseconds(1))), _start(now), _current(0), _size(0), _nodes(), _free(InvalidTimer), _heads(), _occupied()
+	{
+		_heads.fill(InvalidTimer);
+	}
+
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel(TimerWheel&&) noexcept = default;
+
+	TimerWheel& operator=(const TimerWheel&) = delete;
+	TimerWheel& operator=(TimerWheel&&) noexcept = default;
+
+	std::size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+
+	TimerId schedule(Clock::time_point expiry, std::uint64_t payload)
+	{
+		auto id = allocate();
+		_nodes[id].expiry = to_tick(expiry);
+		_nodes[id].payload = payload;
+		insert(id);
+		++_size;
+		return id;
+	}
+
+	void cancel(TimerId id)
+	{
+		if (id >= _nodes.size() || !_nodes[id].active)
+			return;
+
+		unlink(id);
+		release(id);
+		--_size;
+	}
+
+	// Calls on_expired(payload) for every timer which expired until now. Callbacks are allowed
+	// to schedule and cancel timers, including other timers expiring in the same call.
+	template <typename Fn>
+	std::size_t advance(Clock::time_point now, Fn&& on_expired)
+	{
+		auto target = tick_of(now);
+		std::size_t expired = 0;
+		while (_current <= target)
+		{
+			auto next = next_tick();
+			if (!next || *next > target)
+			{
+				_current = target + 1;
+				break;
+			}
+
+			_current = *next;
+			for (std::size_t level = Levels - 1; level > 0; --level)
+			{
+				if ((_current & (level_span(level) - 1)) == 0)
+					cascade(level * SlotCount + ((_current >> (level * SlotBits)) & SlotMask));
+			}
+
+			move_to_pending(_current & SlotMask);
+			++_current;
+
+			while (_heads[PendingList] != InvalidTimer)
+			{
+				auto id = _heads[PendingList];
+				unlink(id);
+
+				// Timers too far in the future are parked at the end of the wheel until they get close enough
+				if (_nodes[id].expiry >= _current)
+				{
+					insert(id);
+					continue;
+				}
+
+				auto payload = _nodes[id].payload;
+				release(id);
+				--_size;
+				++expired;
+				on_expired(payload);
+			}
+		}
+
+		return expired;
+	}
+
+	// Time until the wheel needs to be advanced again, std::nullopt if there are no timers
+	std::optional<std::chrono::milliseconds> time_until_next(Clock::time_point now) const
+	{
+		auto next = next_tick();
+		if (!next)
+			return std::nullopt;
+
+		auto wake_up = _start + *next * _resolution;
+		if (wake_up <= now)
+			return std::chrono::milliseconds(0);
+
+		return std::chrono::ceil<std::chrono::milliseconds>(wake_up - now);
+	}
+
+private:
+	static constexpr std::size_t Levels = 4;
+	static constexpr std::size_t SlotBits = 6;
+	static constexpr std::size_t SlotCount = std::size_t{1} << SlotBits;
+	static constexpr std::uint64_t SlotMask = SlotCount - 1;
+	static constexpr std::size_t PendingList = Levels * SlotCount;
+
+	struct Node
+	{
+		std::uint64_t expiry = 0;
+		std::uint64_t payload = 0;
+		TimerId prev = InvalidTimer;
+		TimerId next = InvalidTimer;
+		std::uint16_t list = 0;
+		bool active = false;
+	};
+
+	static constexpr std::uint64_t level_span(std::size_t level)
+	{
+		return std::uint64_t{1} << (level * SlotBits);
+	}
+
+	static std::uint64_t rotate_right(std::uint64_t value, std::size_t shift)
+	{
+		return (value >> shift) | (value << ((SlotCount - shift) & SlotMask));
+	}
+
+	std::uint64_t tick_of(Clock::time_point time) const
+	{
+		if (time <= _start)
+			return 0;
+		return static_cast<std::uint64_t>((time - _start) / _resolution);
+	}
+
+	std::uint64_t to_tick(Clock::time_point time) const
+	{
+		if (time <= _start)
+			return 0;
+		auto elapsed = time - _start;
+		return static_cast<std::uint64_t>((elapsed + _resolution - Clock::duration{1}) / _resolution);
+	}
+
+	std::optional<std::uint64_t> next_tick() const
+	{
+		std::optional<std::uint64_t> result;
+		for (std::size_t level = 0; level < Levels; ++level)
+		{
+			if (_occupied[level] == 0)
+				continue;
+
+			// Slots of the first level hold the timers themselves while slots of the upper levels
+			// only need attention once the wheel reaches them and they have to be cascaded
+			auto span = level_span(level);
+			auto base = (_current + span - 1) & ~(span - 1);
+			auto first_slot = (base >> (level * SlotBits)) & SlotMask;
+			auto distance = static_cast<std::uint64_t>(__builtin_ctzll(rotate_right(_occupied[level], first_slot)));
+			auto tick = base + distance * span;
+			if (!result || tick < *result)
+				result = tick;
+		}
+		return result;
+	}
+
+	void insert(TimerId id)
+	{
+		auto expiry = std::max(_nodes[id].expiry, _current);
+		auto delta = std::min(expiry - _current, level_span(Levels) - 1);
+		expiry = _current + delta;
+
+		std::size_t level = 0;
+		while (delta >= level_span(level + 1))
+			++level;
+
+		link(id, level * SlotCount + ((expiry >> (level * SlotBits)) & SlotMask));
+	}
+
+	void cascade(std::size_t list)
+	{
+		while (_heads[list] != InvalidTimer)
+		{
+			auto id = _heads[list];
+			unlink(id);
+			insert(id);
+		}
+	}
+
+	void move_to_pending(std::size_t list)
+	{
+		while (_heads[list] != InvalidTimer)
+		{
+			auto id = _heads[list];
+			unlink(id);
+			link(id, PendingList);
+		}
+	}
+
+	void link(TimerId id, std::size_t list)
+	{
+		auto& node = _nodes[id];
+		node.list = static_cast<std::uint16_t>(list);
+		node.prev = InvalidTimer;
+		node.next = _heads[list];
+		if (node.next != InvalidTimer)
+			_nodes[node.next].prev = id;
+		_heads[list] = id;
+
+		if (list != PendingList)
+			_occupied[list / SlotCount] |= std::uint64_t{1} << (list % SlotCount);
+	}
+
+	void unlink(TimerId id)
+	{
+		auto& node = _nodes[id];
+		if (node.prev != InvalidTimer)
+			_nodes[node.prev].next = node.next;
+		else
+			_heads[node.list] = node.next;
+
+		if (node.next != InvalidTimer)
+			_nodes[node.next].prev = node.prev;
+
+		if (node.list != PendingList && _heads[node.list] == InvalidTimer)
+			_occupied[node.list / SlotCount] &= ~(std::uint64_t{1} << (node.list % SlotCount));
+
+		node.prev = node.next = InvalidTimer;
+	}
+
+	TimerId allocate()
+	{
+		TimerId id;
+		if (_free != InvalidTimer)
+		{
+			id = _free;
+			_free = _nodes[id].next;
+		}
+		else
+		{
+			id = static_cast<TimerId>(_nodes.size());
+			_nodes.emplace_back();
+		}
+
+		_nodes[id] = Node{};
+		_nodes[id].active = true;
+		return id;
+	}
+
+	void release(TimerId id)
+	{
+		_nodes[id].active = false;
+		_nodes[id].next = _free;
+		_free = id;
+	}
+
+	Clock::duration _resolution;
+	Clock::time_point _start;
+	std::uint64_t _current;
+	std::size_t _size;
+
+	std::vector<Node> _nodes;
+	TimerId _free;
+	std::array<TimerId, Levels * SlotCount + 1> _heads;
+	std::array<std::uint64_t, Levels> _occupied;
+};
+
+} // namespace ulocal
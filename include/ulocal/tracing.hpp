@@ -0,0 +1,184 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ulocal {
+
+enum class TraceEvent : std::uint8_t
+{
+	Accept,
+	ReadComplete,
+	RequestParsed,
+	RouteResolved,
+	HandlerStart,
+	HandlerEnd,
+	ResponseSerialized,
+	WriteComplete,
+	Close
+};
+
+constexpr std::string_view get_trace_event_name(TraceEvent event)
+{
+	constexpr std::array<std::string_view, 9> names = {
+		"accept",
+		"read_complete",
+		"request_parsed",
+		"route_resolved",
+		"handler_start",
+		"handler_end",
+		"response_serialized",
+		"write_complete",
+		"close"
+	};
+	return names[static_cast<std::size_t>(event)];
+}
+
+struct TraceRecord
+{
+	std::uint64_t timestamp_ns;
+	std::uint64_t connection_id;
+	std::uint64_t request_id;
+	TraceEvent event;
+};
+
+class TraceSink
+{
+public:
+	virtual ~TraceSink() = default;
+
+	virtual void record(const TraceRecord& record) = 0;
+
+	void record(TraceEvent event, std::uint64_t connection_id, std::uint64_t request_id)
+	{
+		auto now = std::chrono::steady_clock::now().time_since_epoch();
+		record(TraceRecord{
+			static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count()),
+			connection_id,
+			request_id,
+			event
+		});
+	}
+};
+
+// Keeps the most recent records, older records are overwritten once the buffer is full
+class TraceRingBuffer : public TraceSink
+{
+public:
+	TraceRingBuffer(std::size_t capacity = 65536) : _slots(), _mask(0), _write_index(0)
+	{
+		std::size_t rounded_capacity = 1;
+		while (rounded_capacity < capacity)
+			rounded_capacity <<= 1;
+
+		_slots = std::make_unique<Slot[]>(rounded_capacity);
+		_mask = rounded_capacity - 1;
+	}
+
+	using TraceSink::record;
+
+	virtual void record(const TraceRecord& record) override
+	{
+		auto index = _write_index.fetch_add(1, std::memory_order_relaxed);
+		auto& slot = _slots[index & _mask];
+
+		// Odd sequence marks the slot as being written to so readers can skip torn records
+		slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.timestamp_ns.store(record.timestamp_ns, std::memory_order_relaxed);
+		slot.connection_id.store(record.connection_id, std::memory_order_relaxed);
+		slot.request_id.store(record.request_id, std::memory_order_relaxed);
+		slot.event.store(record.event, std::memory_order_relaxed);
+		slot.sequence.store(2 * index + 2, std::memory_order_release);
+	}
+
+	std::vector<TraceRecord> get_records() const
+	{
+		auto end = _write_index.load(std::memory_order_acquire);
+		auto begin = end > _mask + 1 ? end - _mask - 1 : 0;
+
+		std::vector<TraceRecord> result;
+		result.reserve(end - begin);
+		for (auto index = begin; index < end; ++index)
+		{
+			const auto& slot = _slots[index & _mask];
+			auto sequence = slot.sequence.load(std::memory_order_acquire);
+			TraceRecord record{
+				slot.timestamp_ns.load(std::memory_order_relaxed),
+				slot.connection_id.load(std::memory_order_relaxed),
+				slot.request_id.load(std::memory_order_relaxed),
+				slot.event.load(std::memory_order_relaxed)
+			};
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (sequence == 2 * index + 2 && slot.sequence.load(std::memory_order_relaxed) == sequence)
+				result.push_back(record);
+		}
+
+		return result;
+	}
+
+	std::string to_chrome_trace() const
+	{
+		std::ostringstream ss;
+		ss << "{\"traceEvents\":[";
+
+		bool first = true;
+		for (const auto& record : get_records())
+		{
+			char phase = 'i';
+			std::string_view name = get_trace_event_name(record.event);
+			if (record.event == TraceEvent::HandlerStart)
+			{
+				phase = 'B';
+				name = "handler";
+			}
+			else if (record.event == TraceEvent::HandlerEnd)
+			{
+				phase = 'E';
+				name = "handler";
+			}
+
+			ss << (first ? "" : ",")
+				<< "{\"name\":\"" << name << "\",\"ph\":\"" << phase << '"'
+				<< ",\"ts\":" << record.timestamp_ns / 1000 << '.' << record.timestamp_ns % 1000 / 100 << record.timestamp_ns % 100 / 10 << record.timestamp_ns % 10
+				<< ",\"pid\":1,\"tid\":" << record.connection_id
+				<< (phase == 'i' ? ",\"s\":\"t\"" : "")
+				<< ",\"args\":{\"request_id\":" << record.request_id << "}}";
+			first = false;
+		}
+
+		ss << "],\"displayTimeUnit\":\"ns\"}";
+		return ss.str();
+	}
+
+private:
+	struct alignas(64) Slot
+	{
+		std::atomic<std::uint64_t> sequence = 0;
+		std::atomic<std::uint64_t> timestamp_ns = 0;
+		std::atomic<std::uint64_t> connection_id = 0;
+		std::atomic<std::uint64_t> request_id = 0;
+		std::atomic<TraceEvent> event = TraceEvent::Accept;
+	};
+
+	std::unique_ptr<Slot[]> _slots;
+	std::size_t _mask;
+	std::atomic<std::uint64_t> _write_index;
+};
+
+} // namespace ulocal
+
+#if defined(ULOCAL_TRACING)
+#define ULOCAL_TRACE(sink, event, connection_id, request_id) \
+	do { if (sink) (sink)->record(::ulocal::TraceEvent::event, connection_id, request_id); } while (0)
+#else
+#define ULOCAL_TRACE(sink, event, connection_id, request_id) \
+	do { } while (0)
+#endif
@@ -1,114 +1,178 @@
 #pragma once
 
-#include <sstream>
-#include <unordered_map>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include <ulocal/url_arg.hpp>
 
 namespace ulocal {
 
+// Arguments of received requests are only parsed once they are accessed for the first time. Const accessors
+// can be called from multiple threads at once, the first one parses the arguments under a lock.
 class UrlArgs
 {
 public:
-	UrlArgs() : _args(), _table() {}
+	UrlArgs() : _query(), _args(), _parse_mutex(), _parsed(true) {}
 
-	auto begin() const { return _args.begin(); }
-	auto end() const { return _args.end(); }
-	std::size_t size() const { return _args.size(); }
+	// Source can be accessed from other threads while it's copied, so its arguments are only copied once they
+	// are parsed, otherwise the copy parses the raw query again by itself
+	UrlArgs(const UrlArgs& rhs) : _query(rhs._query), _args(), _parse_mutex(), _parsed(rhs._parsed.load(std::memory_order_acquire))
+	{
+		if (_parsed)
+			_args = rhs._args;
+	}
+
+	UrlArgs(UrlArgs&& rhs) noexcept : _query(std::move(rhs._query)), _args(std::move(rhs._args)), _parse_mutex(), _parsed(rhs._parsed.load(std::memory_order_relaxed)) {}
+
+	UrlArgs& operator=(const UrlArgs& rhs)
+	{
+		if (this != &rhs)
+		{
+			bool parsed = rhs._parsed.load(std::memory_order_acquire);
+			_query = rhs._query;
+			if (parsed)
+				_args = rhs._args;
+			else
+				_args.clear();
+			_parsed.store(parsed, std::memory_order_relaxed);
+		}
+		return *this;
+	}
+
+	UrlArgs& operator=(UrlArgs&& rhs) noexcept
+	{
+		_query = std::move(rhs._query);
+		_args = std::move(rhs._args);
+		_parsed.store(rhs._parsed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		return *this;
+	}
+
+	auto begin() const { ensure_parsed(); return _args.cbegin(); }
+	auto end() const { ensure_parsed(); return _args.cend(); }
+	std::size_t size() const { ensure_parsed(); return _args.size(); }
 
 	void clear()
 	{
+		_query.clear();
 		_args.clear();
-		_table.clear();
+		_parsed.store(true, std::memory_order_relaxed);
 	}
 
-	bool has_arg(const std::string& name) const
+	bool has_arg(std::string_view name) const
 	{
-		return _table.find(name) != _table.end();
+		return get_arg(name) != nullptr;
 	}
 
-	const UrlArg* get_arg(const std::string& name) const
+	const UrlArg* get_arg(std::string_view name) const
 	{
-		auto itr = _table.find(name);
-		if (itr == _table.end())
-			return nullptr;
+		ensure_parsed();
+		for (const auto& arg : _args)
+		{
+			if (arg.get_name() == name)
+				return &arg;
+		}
 
-		return &itr->second;
+		return nullptr;
 	}
 
 	template <typename T1, typename T2>
 	void add_arg(T1&& name, T2&& value)
 	{
-		auto itr = _table.find(name);
-		if (itr == _table.end())
-		{
-			auto header = UrlArg{std::forward<T1>(name), std::forward<T2>(value)};
-			std::tie(itr, std::ignore) = _table.emplace(header.get_name(), std::move(header));
-			_args.push_back(&itr->second);
-		}
+		if (!has_arg(name))
+			_args.emplace_back(std::forward<T1>(name), std::forward<T2>(value));
 	}
 
 	static std::pair<std::string, UrlArgs> parse_from_resource(std::string_view resource)
+	{
+		auto result = parse_from_received_resource(resource);
+		result.second.ensure_parsed();
+		return result;
+	}
+
+	// Resource has to come from the request line of received request, so the query is already percent-encoded and
+	// it can be written back as it is while the arguments aren't accessed
+	static std::pair<std::string, UrlArgs> parse_from_received_resource(std::string_view resource)
 	{
 		UrlArgs result;
 
 		auto url_params_start = resource.find('?');
 		if (url_params_start != std::string::npos)
 		{
-			auto url_args = std::string_view{resource.data() + url_params_start + 1, resource.length() - url_params_start - 1};
-			auto pos  = url_args.find('&');
-			decltype(pos) old_pos = 0;
-			while (pos != std::string::npos)
-			{
-				auto arg = std::string_view{url_args.data() + old_pos, pos - old_pos};
-				auto [key, value] = parse_url_arg(arg);
-				result.add_arg(std::move(key), std::move(value));
-				old_pos = pos + 1;
-				pos = url_args.find('&', old_pos);
-			}
-
-			auto last_arg = std::string_view{url_args.data() + old_pos, url_args.length() - old_pos};
-			auto [key, value] = parse_url_arg(last_arg);
-			result.add_arg(std::move(key), std::move(value));
+			result._query.assign(resource.data() + url_params_start + 1, resource.length() - url_params_start - 1);
+			result._parsed = result._query.empty();
 		}
 		else
 			url_params_start = resource.length();
 
-		return {std::string{resource.data(), url_params_start}, result};
+		return {std::string{resource.data(), url_params_start}, std::move(result)};
 	}
 
 	friend std::ostream& operator<<(std::ostream& out, const UrlArgs& args)
 	{
-		if (args._args.empty())
-			return out;
+		// Arguments which were never accessed are written back exactly as we received them
+		if (!args._parsed.load(std::memory_order_acquire))
+			return out << '?' << args._query;
 
 		for (std::size_t i = 0; i < args._args.size(); ++i)
 		{
 			out << (i == 0 ? '?' : '&')
-				<< url_encode(args._args[i]->get_name())
+				<< url_encode(args._args[i].get_name())
 				<< '='
-				<< url_encode(args._args[i]->get_value());
+				<< url_encode(args._args[i].get_value());
 		}
 
 		return out;
 	}
 
 private:
-	static std::pair<std::string, std::string> parse_url_arg(const std::string_view& arg)
+	// Raw query is left as it is after parsing, so it can be read without the lock by the threads which still see
+	// the arguments as not parsed
+	void ensure_parsed() const
 	{
-		auto value_pos = arg.find('=');
-		if (value_pos == std::string::npos)
-			return { std::string{arg}, std::string{} };
-
-		return {
-			url_decode(std::string_view{arg.data(), value_pos}),
-			url_decode(std::string_view{arg.data() + value_pos + 1, arg.length() - value_pos - 1})
-		};
+		if (_parsed.load(std::memory_order_acquire))
+			return;
+
+		std::lock_guard<std::mutex> lock(_parse_mutex);
+		if (_parsed.load(std::memory_order_relaxed))
+			return;
+
+		std::string_view query = _query;
+		std::size_t old_pos = 0;
+		while (old_pos <= query.length())
+		{
+			auto pos = query.find('&', old_pos);
+			if (pos == std::string_view::npos)
+				pos = query.length();
+
+			if (pos > old_pos)
+			{
+				auto arg = query.substr(old_pos, pos - old_pos);
+				auto value_pos = arg.find('=');
+				auto name = url_decode(arg.substr(0, value_pos));
+				auto value = value_pos == std::string_view::npos ? std::string{} : url_decode(arg.substr(value_pos + 1));
+
+				auto duplicate = std::find_if(_args.begin(), _args.end(), [&](const auto& existing) {
+					return existing.get_name() == name;
+				});
+				if (duplicate == _args.end())
+					_args.emplace_back(std::move(name), std::move(value));
+			}
+
+			old_pos = pos + 1;
+		}
+
+		_parsed.store(true, std::memory_order_release);
 	}
 
-	std::vector<const UrlArg*> _args;
-	std::unordered_map<std::string, UrlArg> _table;
+	std::string _query;
+	mutable std::vector<UrlArg> _args;
+	mutable std::mutex _parse_mutex;
+	mutable std::atomic<bool> _parsed;
 };
 
 } // namespace ulocal
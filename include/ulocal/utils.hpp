@@ -1,19 +1,115 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace ulocal {
 
+namespace detail {
+
+constexpr std::array<std::uint8_t, 256> make_hex_value_table()
+{
+	std::array<std::uint8_t, 256> result = {};
+	for (std::size_t i = 0; i < result.size(); ++i)
+	{
+		if ('0' <= i && i <= '9')
+			result[i] = static_cast<std::uint8_t>(i - '0');
+		else if ('a' <= i && i <= 'f')
+			result[i] = static_cast<std::uint8_t>(i - 'a' + 10);
+		else if ('A' <= i && i <= 'F')
+			result[i] = static_cast<std::uint8_t>(i - 'A' + 10);
+		else
+			result[i] = 0xFF;
+	}
+	return result;
+}
+
+constexpr std::array<bool, 256> make_unreserved_table()
+{
+	std::array<bool, 256> result = {};
+	for (std::size_t i = 0; i < result.size(); ++i)
+	{
+		result[i] = ('a' <= i && i <= 'z') ||
+			('A' <= i && i <= 'Z') ||
+			('0' <= i && i <= '9') ||
+			i == '-' ||
+			i == '_' ||
+			i == '~' ||
+			i == '.';
+	}
+	return result;
+}
+
+constexpr auto hex_value_table = make_hex_value_table();
+constexpr auto unreserved_table = make_unreserved_table();
+constexpr std::string_view hex_digits = "0123456789abcdef";
+
+inline bool is_unreserved(char c)
+{
+	return unreserved_table[static_cast<unsigned char>(c)];
+}
+
+// Returns position of the first character which needs to be percent-encoded or length of the input if there is none
+inline std::size_t find_reserved(const char* data, std::size_t length)
+{
+	std::size_t pos = 0;
+#if defined(__SSE2__)
+	const auto before_a = _mm_set1_epi8('a' - 1);
+	const auto after_z = _mm_set1_epi8('z' + 1);
+	const auto before_0 = _mm_set1_epi8('0' - 1);
+	const auto after_9 = _mm_set1_epi8('9' + 1);
+	const auto case_bit = _mm_set1_epi8(0x20);
+	const auto dash = _mm_set1_epi8('-');
+	const auto underscore = _mm_set1_epi8('_');
+	const auto tilde = _mm_set1_epi8('~');
+	const auto dot = _mm_set1_epi8('.');
+
+	for (; pos + 16 <= length; pos += 16)
+	{
+		// Bytes above 0x7F are negative so they fail all range checks
+		auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+		auto folded = _mm_or_si128(block, case_bit);
+		auto letter = _mm_and_si128(_mm_cmpgt_epi8(folded, before_a), _mm_cmplt_epi8(folded, after_z));
+		auto digit = _mm_and_si128(_mm_cmpgt_epi8(block, before_0), _mm_cmplt_epi8(block, after_9));
+		auto special = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(block, dash), _mm_cmpeq_epi8(block, underscore)),
+			_mm_or_si128(_mm_cmpeq_epi8(block, tilde), _mm_cmpeq_epi8(block, dot))
+		);
+		auto mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letter, digit), special));
+		if (mask != 0xFFFF)
+			return pos + __builtin_ctz(~mask & 0xFFFF);
+	}
+#endif
+
+	for (; pos < length; ++pos)
+	{
+		if (!is_unreserved(data[pos]))
+			return pos;
+	}
+
+	return length;
+}
+
+} // namespace detail
+
 inline char hex_to_nibble(char c)
 {
-	auto lc = std::tolower(c);
-	if ('0' <= lc && lc <= '9')
-		return (c - '0') & 0x0F;
-	else if ('a' <= lc && lc <= 'f')
-		return (c - 'a' + 10) & 0x0F;
-	else
+	auto value = detail::hex_value_table[static_cast<unsigned char>(c)];
+	if (value == 0xFF)
 		throw std::runtime_error("Invalid nibble value");
+	return static_cast<char>(value);
 }
 
 inline char nibbles_to_char(char high, char low)
@@ -23,11 +119,7 @@ inline char nibbles_to_char(char high, char low)
 
 inline char char_to_hex(char c, bool high)
 {
-	c = high ? ((c >> 4) & 0x0F) : (c & 0x0F);
-	if (0 <= c && c <= 9)
-		return c + '0';
-	else
-		return c - 10 + 'a';
+	return detail::hex_digits[high ? ((c >> 4) & 0x0F) : (c & 0x0F)];
 }
 
 inline char char_to_hex_high(char c) { return char_to_hex(c, true); }
@@ -41,58 +133,54 @@ inline std::string char_to_hex(char c)
 	return result;
 }
 
-template <typename StrT>
-std::string url_decode(const StrT& str)
+// Invalid percent-encoded sequences are left in the result as they are
+inline std::string url_decode(std::string_view str)
 {
 	std::string result;
 	result.reserve(str.length());
 
+	std::size_t old_pos = 0;
 	auto pos = str.find('%');
-	decltype(pos) old_pos = 0;
-	while (pos != std::string::npos)
+	while (pos != std::string_view::npos)
 	{
-		if (pos > old_pos)
-			result.append(str, old_pos, pos - old_pos);
+		result.append(str.data() + old_pos, pos - old_pos);
+		old_pos = pos;
 
-		if (pos + 2 >= str.length())
+		if (pos + 2 < str.length())
 		{
-			break;
+			auto high = detail::hex_value_table[static_cast<unsigned char>(str[pos + 1])];
+			auto low = detail::hex_value_table[static_cast<unsigned char>(str[pos + 2])];
+			if (high != 0xFF && low != 0xFF)
+			{
+				result += static_cast<char>((high << 4) | low);
+				old_pos = pos + 3;
+			}
 		}
-		else
-		{
-			result += nibbles_to_char(str[pos + 1], str[pos + 2]);
-			old_pos = std::min(str.length(), pos + 3);
-			pos = str.find('%', old_pos);
-		}
-	}
 
-	if (old_pos != str.length())
-		result.append(str, old_pos);
+		pos = str.find('%', std::max(pos + 1, old_pos));
+	}
 
+	result.append(str.data() + old_pos, str.length() - old_pos);
 	return result;
 }
 
-template <typename StrT>
-std::string url_encode(const StrT& str)
+inline std::string url_encode(std::string_view str)
 {
 	std::string result;
-	result.reserve(2 * str.length());
+	result.reserve(str.length() + str.length() / 2);
 
-	for (char c : str)
+	std::size_t pos = 0;
+	while (pos < str.length())
 	{
-		if (('a' <= c && c <= 'z') ||
-			('A' <= c && c <= 'Z') ||
-			('0' <= c && c <= '9') ||
-			c == '-' ||
-			c == '_' ||
-			c == '~' ||
-			c == '.')
-		{
-			result += c;
-		}
-		else
+		auto run = detail::find_reserved(str.data() + pos, str.length() - pos);
+		result.append(str.data() + pos, run);
+		pos += run;
+
+		for (; pos < str.length() && !detail::is_unreserved(str[pos]); ++pos)
 		{
-			result += '%' + char_to_hex(c);
+			result += '%';
+			result += char_to_hex_high(str[pos]);
+			result += char_to_hex_low(str[pos]);
 		}
 	}
 
@@ -106,25 +194,105 @@ inline void hash_combine(std::size_t& seed, const T& v)
 	seed ^= hasher(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
 }
 
+namespace detail {
+
+constexpr std::array<char, 256> make_ascii_lowercase_table()
+{
+	std::array<char, 256> result = {};
+	for (std::size_t i = 0; i < result.size(); ++i)
+		result[i] = static_cast<char>('A' <= i && i <= 'Z' ? i - 'A' + 'a' : i);
+	return result;
+}
+
+constexpr auto ascii_lowercase_table = make_ascii_lowercase_table();
+
+inline std::uint64_t load_word(const char* data, std::size_t count = sizeof(std::uint64_t))
+{
+	std::uint64_t result = 0;
+	std::memcpy(&result, data, count);
+	return result;
+}
+
+// Lowercases all ASCII letters in 8 bytes at once, bytes outside of ASCII are left untouched
+inline std::uint64_t ascii_lowercase_word(std::uint64_t word)
+{
+	constexpr std::uint64_t ones = 0x0101010101010101ull;
+	auto low_bits = word & (0x7F * ones);
+	auto above_z = low_bits + (0x7F - 'Z') * ones;
+	auto from_a = low_bits + (0x80 - 'A') * ones;
+	auto uppercase = (from_a ^ above_z) & ~word & (0x80 * ones);
+	return word | (uppercase >> 2);
+}
+
+inline std::uint64_t hash_mix(std::uint64_t a, std::uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+	auto result = static_cast<unsigned __int128>(a) * b;
+	return static_cast<std::uint64_t>(result) ^ static_cast<std::uint64_t>(result >> 64);
+#else
+	a ^= b;
+	a *= 0x9E3779B97F4A7C15ull;
+	return a ^ (a >> 32);
+#endif
+}
+
+} // namespace detail
+
+inline char ascii_tolower(char c)
+{
+	return detail::ascii_lowercase_table[static_cast<unsigned char>(c)];
+}
+
 template <typename StrT>
 std::string lowercase(const StrT& str)
 {
-	std::string result;
-	result.reserve(size(str));
-	std::transform(begin(str), end(str), begin(result), [](char c) {
-		return std::tolower(c);
-	});
+	std::string result(std::begin(str), std::end(str));
+	std::transform(result.begin(), result.end(), result.begin(), ascii_tolower);
 	return result;
 }
 
+inline bool icase_equal(std::string_view str1, std::string_view str2)
+{
+	if (str1.length() != str2.length())
+		return false;
+
+	constexpr auto word_size = sizeof(std::uint64_t);
+	std::size_t i = 0;
+	for (; i + word_size <= str1.length(); i += word_size)
+	{
+		auto word1 = detail::load_word(str1.data() + i);
+		auto word2 = detail::load_word(str2.data() + i);
+		if (word1 != word2 && detail::ascii_lowercase_word(word1) != detail::ascii_lowercase_word(word2))
+			return false;
+	}
+
+	for (; i < str1.length(); ++i)
+	{
+		if (ascii_tolower(str1[i]) != ascii_tolower(str2[i]))
+			return false;
+	}
+
+	return true;
+}
+
 template <typename StrT1, typename StrT2>
 bool icase_compare(const StrT1& str1, const StrT2& str2)
 {
-	return std::equal(
-		std::begin(str1), std::end(str1),
-		std::begin(str2), std::end(str2),
-		[](auto c1, auto c2) { return std::tolower(c1) == std::tolower(c2); }
-	);
+	return icase_equal(std::string_view{str1}, std::string_view{str2});
+}
+
+inline std::size_t icase_hash(std::string_view str)
+{
+	constexpr auto word_size = sizeof(std::uint64_t);
+	std::uint64_t seed = 0xA0761D6478BD642Full ^ str.length();
+	std::size_t i = 0;
+	for (; i + word_size <= str.length(); i += word_size)
+		seed = detail::hash_mix(seed ^ detail::ascii_lowercase_word(detail::load_word(str.data() + i)), 0xE7037ED1A0B428DBull);
+
+	if (i < str.length())
+		seed = detail::hash_mix(seed ^ detail::ascii_lowercase_word(detail::load_word(str.data() + i, str.length() - i)), 0xE7037ED1A0B428DBull);
+
+	return static_cast<std::size_t>(detail::hash_mix(seed, 0x8EBC6AF09C88C6E3ull));
 }
 
 template <typename StrT>
@@ -136,22 +304,37 @@ std::string lstrip(const StrT& str)
 	return std::string{str.data() + pos, str.length() - pos};
 }
 
+inline std::string_view strip(std::string_view str)
+{
+	auto start = str.find_first_not_of(" \r\n\t\v");
+	if (start == std::string_view::npos)
+		return {};
+	auto end = str.find_last_not_of(" \r\n\t\v");
+	return str.substr(start, end - start + 1);
+}
+
+template <typename T>
+void append_number(std::string& out, T value)
+{
+	char buffer[64];
+	auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+	if (error == std::errc{})
+		out.append(buffer, end - buffer);
+}
+
 struct CaseInsensitiveHash
 {
-	std::size_t operator()(const std::string& str) const
+	std::size_t operator()(std::string_view str) const
 	{
-		std::size_t seed = 0;
-		for (auto c : str)
-			hash_combine(seed, std::tolower(c));
-		return seed;
+		return icase_hash(str);
 	}
 };
 
 struct CaseInsensitiveCompare
 {
-	bool operator()(const std::string& str1, const std::string& str2) const
+	bool operator()(std::string_view str1, std::string_view str2) const
 	{
-		return icase_compare(str1, str2);
+		return icase_equal(str1, str2);
 	}
 };
 
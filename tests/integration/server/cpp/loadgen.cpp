@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <ulocal/ulocal.hpp>
+
+using namespace ulocal;
+using Clock = std::chrono::steady_clock;
+
+struct Options
+{
+	std::size_t connections = 4;
+	std::chrono::milliseconds duration = std::chrono::seconds(5);
+	std::size_t body_size = 128;
+	std::size_t response_size = 1024;
+	bool keep_alive = false;
+	bool json = false;
+	std::string trace_file;
+	PollerBackend poller = PollerBackend::Auto;
+	std::vector<std::pair<std::string, unsigned>> mix = {{"small", 80}, {"echo", 15}, {"large", 5}};
+};
+
+struct WorkerResult
+{
+	std::vector<std::uint64_t> latencies;
+	std::uint64_t errors = 0;
+	std::uint64_t connects = 0;
+	std::uint64_t bytes_received = 0;
+};
+
+void usage()
+{
+	std::cout << "loadgen [OPTIONS]\n"
+		"\n"
+		"Starts HTTP server on a temporary socket and measures its throughput and latency.\n"
+		"\n"
+		"  --connections N      Number of concurrent client connections (default: 4)\n"
+		"  --duration SECONDS   Duration of the measurement (default: 5)\n"
+		"  --body-size BYTES    Size of the request body sent to /echo (default: 128)\n"
+		"  --response-size BYTES Size of the response returned by /large (default: 1024)\n"
+		"  --mix SPEC           Request mix as comma separated ROUTE:WEIGHT pairs,\n"
+		"                       routes are small, echo and large, at least one weight has to be\n"
+		"                       non-zero (default: small:80,echo:15,large:5)\n"
+		"  --keep-alive         Reuse connections as long as the server allows it\n"
+		"  --json               Print results as JSON\n"
+		"  --poller BACKEND     Server poller backend, one of auto, epoll and poll (default: auto)\n"
+		"  --trace FILE         Write server request lifecycle events as Chrome trace JSON,\n"
+		"                       requires ulocal built with -DULOCAL_TRACING=ON\n";
+}
+
+template <typename T>
+std::optional<T> parse_number(std::string_view str)
+{
+	return KeyValue{"", str}.try_get_value_as<T>();
+}
+
+std::optional<Options> parse_options(int argc, char* argv[])
+{
+	constexpr PollerBackend backends[] = {PollerBackend::Auto, PollerBackend::Epoll, PollerBackend::Poll};
+
+	Options result;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		auto next = [&]() -> std::optional<std::string> {
+			if (i + 1 >= argc)
+				return std::nullopt;
+			return std::string{argv[++i]};
+		};
+
+		if (arg == "--keep-alive")
+			result.keep_alive = true;
+		else if (arg == "--json")
+			result.json = true;
+		else if (arg == "--connections" || arg == "--duration" || arg == "--body-size" || arg == "--response-size")
+		{
+			auto value = next();
+			auto number = value ? parse_number<std::size_t>(*value) : std::nullopt;
+			if (!number)
+				return std::nullopt;
+
+			if (arg == "--connections")
+				result.connections = std::max<std::size_t>(1, *number);
+			else if (arg == "--duration")
+				result.duration = std::chrono::seconds(*number);
+			else if (arg == "--body-size")
+				result.body_size = *number;
+			else
+				result.response_size = *number;
+		}
+		else if (arg == "--poller")
+		{
+			auto value = next();
+			if (!value)
+				return std::nullopt;
+
+			auto backend = std::find_if(std::begin(backends), std::end(backends), [&](auto backend) {
+				return get_poller_backend_name(backend) == *value;
+			});
+			if (backend == std::end(backends))
+				return std::nullopt;
+			result.poller = *backend;
+		}
+		else if (arg == "--trace")
+		{
+#if defined(ULOCAL_TRACING)
+			auto value = next();
+			if (!value)
+				return std::nullopt;
+			result.trace_file = *value;
+#else
+			// Server wouldn't record anything so the trace would always be empty
+			return std::nullopt;
+#endif
+		}
+		else if (arg == "--mix")
+		{
+			auto value = next();
+			if (!value)
+				return std::nullopt;
+
+			result.mix.clear();
+			std::istringstream ss(*value);
+			std::string item;
+			while (std::getline(ss, item, ','))
+			{
+				auto colon = item.find(':');
+				auto route = item.substr(0, colon);
+				auto weight = colon == std::string::npos ? std::optional<unsigned>{1} : parse_number<unsigned>(std::string_view{item}.substr(colon + 1));
+				if (!weight || (route != "small" && route != "echo" && route != "large"))
+					return std::nullopt;
+				result.mix.emplace_back(route, *weight);
+			}
+
+			// At least one route has to be picked, otherwise there would be nothing to send
+			if (std::all_of(result.mix.begin(), result.mix.end(), [](const auto& item) { return item.second == 0; }))
+				return std::nullopt;
+		}
+		else
+			return std::nullopt;
+	}
+
+	return result;
+}
+
+double cpu_seconds()
+{
+	rusage usage;
+	::getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+bool wait_for(const Socket<>& socket, short events)
+{
+	pollfd fd = {socket.get_fd(), events, 0};
+	return ::poll(&fd, 1, 1000) > 0 && !(fd.revents & (POLLERR | POLLNVAL));
+}
+
+void run_worker(const std::string& socket_path, const Options& options, const std::vector<std::string>& requests, Clock::time_point deadline, unsigned seed, WorkerResult& result)
+{
+	std::mt19937 rng(seed);
+	std::uniform_int_distribution<std::size_t> pick(0, requests.size() - 1);
+	std::optional<Socket<>> socket;
+	HttpResponseParser parser;
+
+	while (Clock::now() < deadline)
+	{
+		const auto& request = requests[pick(rng)];
+		auto start = Clock::now();
+
+		try
+		{
+			if (!socket)
+			{
+				socket.emplace();
+				socket->connect(socket_path);
+				++result.connects;
+			}
+
+			std::string_view data = request;
+			while (!data.empty())
+			{
+				data.remove_prefix(socket->write(data));
+				if (!data.empty() && !wait_for(*socket, POLLOUT))
+					throw SocketError("Timed out while sending request");
+			}
+
+			std::optional<HttpResponse> response;
+			bool closed = false;
+			while (!response && !closed)
+			{
+				if (!wait_for(*socket, POLLIN))
+					throw SocketError("Timed out while waiting for response");
+
+				auto before = socket->get_stream().get_size();
+				socket->read();
+				auto received = socket->get_stream().get_size();
+				closed = received == before;
+				result.bytes_received += received - before;
+				response = parser.parse(socket->get_stream());
+			}
+
+			if (!response)
+				throw SocketError("Server closed connection before sending response");
+
+			result.latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+
+			auto connection = response->get_header(HttpHeaderId::Connection);
+			if (!options.keep_alive || !connection || !icase_equal(connection->get_value(), "keep-alive"))
+				socket.reset();
+		}
+		catch (const std::exception&)
+		{
+			++result.errors;
+			socket.reset();
+			parser = HttpResponseParser{};
+		}
+	}
+}
+
+std::vector<std::string> build_requests(const Options& options)
+{
+	std::vector<std::string> result;
+	for (const auto& [route, weight] : options.mix)
+	{
+		HttpRequest request = route == "echo"
+			? HttpRequest{"POST", "/echo", std::string(options.body_size, 'x')}
+			: HttpRequest{"GET", "/" + route};
+		request.add_header(HttpHeaderId::Host, "localhost");
+		request.add_header(HttpHeaderId::Connection, options.keep_alive ? "keep-alive" : "close");
+		request.calculate_content_length();
+
+		auto dump = request.dump();
+		for (unsigned i = 0; i < weight; ++i)
+			result.push_back(dump);
+	}
+	return result;
+}
+
+std::uint64_t percentile(const std::vector<std::uint64_t>& sorted, double p)
+{
+	if (sorted.empty())
+		return 0;
+	auto index = static_cast<std::size_t>(p * (sorted.size() - 1));
+	return sorted[index];
+}
+
+int main(int argc, char* argv[])
+{
+	auto maybe_options = parse_options(argc, argv);
+	if (!maybe_options)
+	{
+		usage();
+		return 1;
+	}
+	auto options = std::move(maybe_options).value();
+
+	char dir_template[] = "/tmp/ulocal-loadgen-XXXXXX";
+	if (!::mkdtemp(dir_template))
+	{
+		std::cerr << "Unable to create temporary directory" << std::endl;
+		return 1;
+	}
+	std::string socket_path = std::string{dir_template} + "/server.sock";
+
+	std::string small_body = "{\"status\": \"ok\"}";
+	std::string large_body(options.response_size, 'x');
+
+	TraceRingBuffer trace;
+	HttpServer server(socket_path);
+	server.set_keep_alive(true);
+	server.set_poller_backend(options.poller);
+	if (!options.trace_file.empty())
+		server.set_trace_sink(&trace);
+	server.endpoint({"GET"}, "/small", [&](const HttpRequest&) -> HttpResponse {
+		return {200, small_body};
+	});
+	server.endpoint({"GET"}, "/large", [&](const HttpRequest&) -> HttpResponse {
+		return {200, large_body};
+	});
+	server.endpoint({"POST"}, "/echo", [](const HttpRequest& request) -> HttpResponse {
+		return {200, request.get_content()};
+	});
+	server.serve();
+
+	auto requests = build_requests(options);
+	std::vector<WorkerResult> results(options.connections);
+	std::vector<std::thread> workers;
+
+	auto cpu_start = cpu_seconds();
+	auto start = Clock::now();
+	auto deadline = start + options.duration;
+	for (std::size_t i = 0; i < options.connections; ++i)
+		workers.emplace_back(run_worker, std::cref(socket_path), std::cref(options), std::cref(requests), deadline, static_cast<unsigned>(i), std::ref(results[i]));
+	for (auto& worker : workers)
+		worker.join();
+	auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	auto cpu = cpu_seconds() - cpu_start;
+
+	server.terminate();
+	server.wait_until_done();
+	::unlink(socket_path.c_str());
+	::rmdir(dir_template);
+
+	if (!options.trace_file.empty())
+		std::ofstream{options.trace_file} << trace.to_chrome_trace();
+
+	WorkerResult total;
+	for (auto& result : results)
+	{
+		total.latencies.insert(total.latencies.end(), result.latencies.begin(), result.latencies.end());
+		total.errors += result.errors;
+		total.connects += result.connects;
+		total.bytes_received += result.bytes_received;
+	}
+	std::sort(total.latencies.begin(), total.latencies.end());
+
+	auto count = total.latencies.size();
+	auto rps = count / elapsed;
+	// Client threads run in the same process so this is an upper bound of what the server itself uses
+	auto cpu_per_request_us = count ? cpu / count * 1e6 : 0.0;
+	auto us = [](std::uint64_t ns) { return ns / 1000.0; };
+
+	if (options.json)
+	{
+		std::cout << std::fixed << std::setprecision(3)
+			<< "{\"connections\": " << options.connections
+			<< ", \"poller\": \"" << get_poller_backend_name(server.get_poller_backend()) << '"'
+			<< ", \"keep_alive\": " << (options.keep_alive ? "true" : "false")
+			<< ", \"duration_s\": " << elapsed
+			<< ", \"requests\": " << count
+			<< ", \"errors\": " << total.errors
+			<< ", \"connects\": " << total.connects
+			<< ", \"bytes_received\": " << total.bytes_received
+			<< ", \"requests_per_second\": " << rps
+			<< ", \"latency_us\": {\"p50\": " << us(percentile(total.latencies, 0.5))
+			<< ", \"p99\": " << us(percentile(total.latencies, 0.99))
+			<< ", \"p999\": " << us(percentile(total.latencies, 0.999))
+			<< ", \"max\": " << us(count ? total.latencies.back() : 0)
+			<< "}, \"cpu_per_request_us\": " << cpu_per_request_us << "}" << std::endl;
+	}
+	else
+	{
+		std::cout << std::fixed << std::setprecision(2)
+			<< "Connections:        " << options.connections << (options.keep_alive ? " (keep-alive)" : "") << '\n'
+			<< "Poller:             " << get_poller_backend_name(server.get_poller_backend()) << '\n'
+			<< "Duration:           " << elapsed << " s\n"
+			<< "Requests:           " << count << " (" << total.errors << " errors, " << total.connects << " connects)\n"
+			<< "Throughput:         " << rps << " req/s\n"
+			<< "Latency p50:        " << us(percentile(total.latencies, 0.5)) << " us\n"
+			<< "Latency p99:        " << us(percentile(total.latencies, 0.99)) << " us\n"
+			<< "Latency p999:       " << us(percentile(total.latencies, 0.999)) << " us\n"
+			<< "CPU per request:    " << cpu_per_request_us << " us (whole process)" << std::endl;
+	}
+
+	return total.errors == 0 ? 0 : 2;
+}
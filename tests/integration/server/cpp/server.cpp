@@ -35,10 +35,10 @@ int main(int argc, char* argv[])
 		};
 
 		for (const auto& header : request.get_headers())
-			response["request"]["headers"][header->get_name()] = header->get_value();
+			response["request"]["headers"][header.get_name()] = header.get_value();
 
 		for (const auto& arg : request.get_arguments())
-			response["request"]["args"][arg->get_name()] = arg->get_value();
+			response["request"]["args"][arg.get_name()] = arg.get_value();
 
 		return {200, response.dump()};
 	};
@@ -54,6 +54,7 @@ int main(int argc, char* argv[])
 	server.endpoint({"POST"}, "/different_handlers_for_different_methods", [&](const HttpRequest&) -> HttpResponse {
 		return 500;
 	});
+	server.metrics_endpoint();
 
 	server.serve();
 
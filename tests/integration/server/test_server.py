@@ -378,3 +378,16 @@ def test_multiple_requests_one_session(ulocal_server):
             'content': '{"key3": "value3", "key4": 4}'
         }
     }
+
+
+def test_metrics_endpoint(ulocal_server):
+    session = requests_unixsocket.Session()
+    send_json(ulocal_server, 'GET', '/get', {}, session=session)
+    send_json(ulocal_server, 'GET', '/error/500', {}, session=session)
+    response = session.get('http+unix://{}/metrics'.format(ulocal_server.replace('/', '%2F')))
+
+    assert response.status_code == 200
+    assert response.headers['Content-Type'].startswith('text/plain')
+    assert 'ulocal_requests_total{route="/get",code="200"}' in response.text
+    assert 'ulocal_requests_total{route="/error/500",code="500"}' in response.text
+    assert 'ulocal_route_handler_duration_seconds_count{route="/get"}' in response.text
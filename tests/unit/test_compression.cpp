@@ -0,0 +1,90 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <ulocal/compression.hpp>
+#include <ulocal/http_response.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestCompression : public ::testing::Test {};
+
+TEST_F(TestCompression,
+NegotiateEncoding) {
+	EXPECT_EQ(negotiate_content_encoding(""), ContentEncoding::Identity);
+	EXPECT_EQ(negotiate_content_encoding("identity"), ContentEncoding::Identity);
+	EXPECT_EQ(negotiate_content_encoding("br"), ContentEncoding::Identity);
+	EXPECT_EQ(negotiate_content_encoding("gzip"), ContentEncoding::Gzip);
+	EXPECT_EQ(negotiate_content_encoding("deflate"), ContentEncoding::Deflate);
+	EXPECT_EQ(negotiate_content_encoding("deflate, gzip"), ContentEncoding::Gzip);
+	EXPECT_EQ(negotiate_content_encoding(" GZIP ; q=0.5 , deflate"), ContentEncoding::Deflate);
+	EXPECT_EQ(negotiate_content_encoding("gzip;q=0, deflate;q=0"), ContentEncoding::Identity);
+	EXPECT_EQ(negotiate_content_encoding("gzip;q=0, *"), ContentEncoding::Deflate);
+	EXPECT_EQ(negotiate_content_encoding("*;q=0.1"), ContentEncoding::Gzip);
+	EXPECT_EQ(negotiate_content_encoding("gzip;q=abc, deflate;q=0.2"), ContentEncoding::Deflate);
+}
+
+#ifdef ULOCAL_COMPRESSION
+
+TEST_F(TestCompression,
+RoundTrip) {
+	std::string content;
+	for (int i = 0; i < 10000; ++i)
+		content += "line " + std::to_string(i) + "\n";
+
+	for (auto encoding : {ContentEncoding::Gzip, ContentEncoding::Deflate})
+	{
+		// Second round reuses the context of the thread
+		for (int round = 0; round < 2; ++round)
+		{
+			auto compressed = compress(content, encoding);
+			EXPECT_LT(compressed.length(), content.length());
+			EXPECT_EQ(decompress(compressed, encoding), content);
+		}
+	}
+
+	EXPECT_EQ(static_cast<unsigned char>(compress(content, ContentEncoding::Gzip)[0]), 0x1fu);
+	EXPECT_EQ(decompress(compress("", ContentEncoding::Gzip), ContentEncoding::Gzip), "");
+}
+
+TEST_F(TestCompression,
+DecompressContent) {
+	std::string content(50000, 'x');
+	HttpResponse response{200, compress(content, ContentEncoding::Gzip)};
+	response.add_header(HttpHeaderId::ContentEncoding, "gzip");
+	response.calculate_content_length();
+
+	decompress_content(response);
+	EXPECT_EQ(response.get_content(), content);
+	EXPECT_FALSE(response.has_header(HttpHeaderId::ContentEncoding));
+	ASSERT_TRUE(response.get_header(HttpHeaderId::ContentLength));
+	EXPECT_EQ(response.get_header(HttpHeaderId::ContentLength)->get_value(), "50000");
+}
+
+TEST_F(TestCompression,
+DecompressInvalidData) {
+	EXPECT_THROW(decompress("not compressed at all", ContentEncoding::Gzip), CompressionError);
+
+	auto truncated = compress(std::string(50000, 'x'), ContentEncoding::Deflate);
+	truncated.resize(truncated.length() / 2);
+	EXPECT_THROW(decompress(truncated, ContentEncoding::Deflate), CompressionError);
+}
+
+TEST_F(TestCompression,
+DecompressionLimit) {
+	std::string content(100000, 'x');
+	auto compressed = compress(content, ContentEncoding::Gzip);
+	EXPECT_EQ(decompress(compressed, ContentEncoding::Gzip, content.length()), content);
+	EXPECT_THROW(decompress(compressed, ContentEncoding::Gzip, content.length() - 1), CompressionError);
+	EXPECT_THROW(decompress(content, ContentEncoding::Identity, content.length() - 1), CompressionError);
+
+	// Few kilobytes which would expand to 64 MB are rejected early
+	auto bomb = compress(std::string(64 * 1024 * 1024, '\0'), ContentEncoding::Deflate);
+	EXPECT_LT(bomb.length(), 100000u);
+	HttpResponse response{200, bomb};
+	response.add_header(HttpHeaderId::ContentEncoding, "deflate");
+	EXPECT_THROW(decompress_content(response, 1024 * 1024), CompressionError);
+	EXPECT_EQ(response.get_content(), bomb);
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <ulocal/conditional.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestConditional : public ::testing::Test
+{
+public:
+	HttpRequest request(const std::string& method, const std::string& header, const std::string& value)
+	{
+		HttpHeaderTable headers;
+		headers.add_header(header, value);
+		return HttpRequest{method, "/", std::move(headers), std::string{}};
+	}
+};
+
+TEST_F(TestConditional,
+FormatAndParseHttpDate) {
+	auto time = std::chrono::system_clock::from_time_t(784111777);
+	EXPECT_EQ(format_http_date(time), "Sun, 06 Nov 1994 08:49:37 GMT");
+	EXPECT_EQ(parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT"), time);
+	EXPECT_EQ(parse_http_date(format_http_date(std::chrono::system_clock::from_time_t(0))), std::chrono::system_clock::from_time_t(0));
+
+	EXPECT_FALSE(parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT"));
+	EXPECT_FALSE(parse_http_date("Sun Nov  6 08:49:37 1994"));
+	EXPECT_FALSE(parse_http_date("Sun, 06 Abc 1994 08:49:37 GMT"));
+	EXPECT_FALSE(parse_http_date("Sun, 06 Nov 1994 25:49:37 GMT"));
+	EXPECT_FALSE(parse_http_date(""));
+}
+
+TEST_F(TestConditional,
+ApplyValidator) {
+	ResponseValidator validator{"v1", true, std::chrono::system_clock::from_time_t(784111777)};
+	HttpResponse response{200, "abc"};
+	validator.apply(response);
+	ASSERT_TRUE(response.get_header(HttpHeaderId::ETag));
+	EXPECT_EQ(response.get_header(HttpHeaderId::ETag)->get_value(), "W/\"v1\"");
+	ASSERT_TRUE(response.get_header(HttpHeaderId::LastModified));
+	EXPECT_EQ(response.get_header(HttpHeaderId::LastModified)->get_value(), "Sun, 06 Nov 1994 08:49:37 GMT");
+
+	HttpResponse own_etag{200, "abc"};
+	own_etag.add_header(HttpHeaderId::ETag, "\"own\"");
+	ResponseValidator{"v1", false, std::nullopt}.apply(own_etag);
+	EXPECT_EQ(own_etag.get_header(HttpHeaderId::ETag)->get_value(), "\"own\"");
+	EXPECT_FALSE(own_etag.has_header(HttpHeaderId::LastModified));
+}
+
+TEST_F(TestConditional,
+WeakenEtag) {
+	HttpResponse response{200, "abc"};
+	ResponseValidator{"v1", false, std::nullopt}.apply(response);
+	weaken_etag(response);
+	EXPECT_EQ(response.get_header(HttpHeaderId::ETag)->get_value(), "W/\"v1\"");
+
+	// Already weak tag stays as it is
+	weaken_etag(response);
+	EXPECT_EQ(response.get_header(HttpHeaderId::ETag)->get_value(), "W/\"v1\"");
+
+	HttpResponse without_etag{200, "abc"};
+	weaken_etag(without_etag);
+	EXPECT_FALSE(without_etag.has_header(HttpHeaderId::ETag));
+}
+
+TEST_F(TestConditional,
+IfNoneMatch) {
+	ResponseValidator validator{"v2", false, std::nullopt};
+	EXPECT_TRUE(is_not_modified(request("GET", "If-None-Match", "\"v2\""), validator));
+	EXPECT_TRUE(is_not_modified(request("HEAD", "If-None-Match", "W/\"v2\""), validator));
+	EXPECT_TRUE(is_not_modified(request("GET", "If-None-Match", "\"v1\", \"a,b\" , \"v2\""), validator));
+	EXPECT_TRUE(is_not_modified(request("GET", "If-None-Match", "*"), validator));
+	EXPECT_FALSE(is_not_modified(request("GET", "If-None-Match", "\"v1\""), validator));
+	EXPECT_FALSE(is_not_modified(request("GET", "If-None-Match", "\"v2"), validator));
+	EXPECT_FALSE(is_not_modified(request("POST", "If-None-Match", "\"v2\""), validator));
+	EXPECT_FALSE(is_not_modified(request("GET", "If-None-Match", "\"v2\""), ResponseValidator{}));
+	EXPECT_FALSE(is_not_modified(HttpRequest{"GET", "/"}, validator));
+}
+
+TEST_F(TestConditional,
+IfModifiedSince) {
+	ResponseValidator validator{std::nullopt, false, std::chrono::system_clock::from_time_t(784111777) + std::chrono::milliseconds(500)};
+	EXPECT_TRUE(is_not_modified(request("GET", "If-Modified-Since", "Sun, 06 Nov 1994 08:49:37 GMT"), validator));
+	EXPECT_TRUE(is_not_modified(request("GET", "If-Modified-Since", "Mon, 07 Nov 1994 08:49:37 GMT"), validator));
+	EXPECT_FALSE(is_not_modified(request("GET", "If-Modified-Since", "Sun, 06 Nov 1994 08:49:36 GMT"), validator));
+	EXPECT_FALSE(is_not_modified(request("GET", "If-Modified-Since", "yesterday"), validator));
+	EXPECT_FALSE(is_not_modified(request("GET", "If-Modified-Since", "Sun, 06 Nov 1994 08:49:37 GMT"), ResponseValidator{}));
+
+	// If-None-Match takes precedence over If-Modified-Since
+	HttpHeaderTable headers;
+	headers.add_header("If-None-Match", "\"other\"");
+	headers.add_header("If-Modified-Since", "Mon, 07 Nov 1994 08:49:37 GMT");
+	EXPECT_FALSE(is_not_modified(HttpRequest{"GET", "/", std::move(headers), std::string{}}, ResponseValidator{"v1", false, validator.last_modified}));
+}
@@ -0,0 +1,63 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <ulocal/file_descriptor.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestFileDescriptor : public ::testing::Test
+{
+public:
+	static bool is_open(int fd) { return ::fcntl(fd, F_GETFD) != -1; }
+};
+
+TEST_F(TestFileDescriptor,
+ClosesOwnedDescriptor) {
+	int fds[2];
+	ASSERT_EQ(::pipe2(fds, O_CLOEXEC), 0);
+	::close(fds[1]);
+
+	{
+		FileDescriptor fd{fds[0]};
+		EXPECT_TRUE(fd);
+		EXPECT_EQ(fd.get(), fds[0]);
+	}
+	EXPECT_FALSE(is_open(fds[0]));
+	EXPECT_FALSE(FileDescriptor{});
+}
+
+TEST_F(TestFileDescriptor,
+CopyDuplicatesDescriptor) {
+	int fds[2];
+	ASSERT_EQ(::pipe2(fds, O_CLOEXEC), 0);
+	FileDescriptor read_end{fds[0]};
+	FileDescriptor write_end{fds[1]};
+
+	auto copy = write_end;
+	EXPECT_NE(copy.get(), write_end.get());
+	EXPECT_TRUE(::fcntl(copy.get(), F_GETFD) & FD_CLOEXEC);
+
+	write_end.reset();
+	ASSERT_EQ(::write(copy.get(), "x", 1), 1);
+	char c;
+	EXPECT_EQ(::read(read_end.get(), &c, 1), 1);
+	EXPECT_EQ(c, 'x');
+}
+
+TEST_F(TestFileDescriptor,
+MoveAndRelease) {
+	int fds[2];
+	ASSERT_EQ(::pipe2(fds, O_CLOEXEC), 0);
+	FileDescriptor read_end{fds[0]};
+	FileDescriptor write_end{fds[1]};
+
+	auto moved = std::move(write_end);
+	EXPECT_FALSE(write_end);
+	EXPECT_EQ(moved.get(), fds[1]);
+
+	auto raw = moved.release();
+	EXPECT_FALSE(moved);
+	EXPECT_TRUE(is_open(raw));
+	::close(raw);
+}
@@ -0,0 +1,142 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <ulocal/http_header_table.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestHttpHeaderTable : public ::testing::Test {};
+
+TEST_F(TestHttpHeaderTable,
+InitEmpty) {
+	HttpHeaderTable headers;
+
+	EXPECT_EQ(headers.size(), 0u);
+	EXPECT_EQ(headers.begin(), headers.end());
+	EXPECT_FALSE(headers.has_header("Content-Length"));
+	EXPECT_FALSE(headers.has_header(HttpHeaderId::ContentLength));
+}
+
+TEST_F(TestHttpHeaderTable,
+KnownHeaderIds) {
+	EXPECT_EQ(get_header_id("Content-Length"), HttpHeaderId::ContentLength);
+	EXPECT_EQ(get_header_id("content-length"), HttpHeaderId::ContentLength);
+	EXPECT_EQ(get_header_id("CONNECTION"), HttpHeaderId::Connection);
+	EXPECT_EQ(get_header_id("Transfer-Encoding"), HttpHeaderId::TransferEncoding);
+	EXPECT_EQ(get_header_id("X-Custom"), HttpHeaderId::Unknown);
+	EXPECT_EQ(get_header_id(""), HttpHeaderId::Unknown);
+
+	EXPECT_EQ(get_header_name(HttpHeaderId::ContentType), "Content-Type");
+	EXPECT_EQ(get_header_name(HttpHeaderId::Host), "Host");
+	EXPECT_EQ(get_header_name(HttpHeaderId::Unknown), "");
+}
+
+TEST_F(TestHttpHeaderTable,
+AddHeaderByName) {
+	HttpHeaderTable headers;
+	headers.add_header("Content-Length", 12);
+	headers.add_header("X-Custom", "value");
+
+	EXPECT_EQ(headers.size(), 2u);
+	EXPECT_EQ(headers.get_header("content-length")->get_name(), "Content-Length");
+	EXPECT_EQ(headers.get_header(HttpHeaderId::ContentLength)->get_value(), "12");
+	EXPECT_EQ(headers.get_header("x-custom")->get_value(), "value");
+	EXPECT_EQ(headers.get_header("X-Other"), nullptr);
+}
+
+TEST_F(TestHttpHeaderTable,
+AddHeaderById) {
+	HttpHeaderTable headers;
+	headers.add_header(HttpHeaderId::Connection, "close");
+
+	EXPECT_EQ(headers.size(), 1u);
+	EXPECT_EQ(headers.get_header("connection")->get_name(), "Connection");
+	EXPECT_EQ(headers.get_header("connection")->get_value(), "close");
+}
+
+TEST_F(TestHttpHeaderTable,
+FirstHeaderWins) {
+	HttpHeaderTable headers;
+	headers.add_header("Connection", "close");
+	headers.add_header("connection", "keep-alive");
+	headers.add_header(HttpHeaderId::Connection, "upgrade");
+	headers.add_header("X-Custom", "1");
+	headers.add_header("x-custom", "2");
+
+	EXPECT_EQ(headers.size(), 2u);
+	EXPECT_EQ(headers.get_header(HttpHeaderId::Connection)->get_value(), "close");
+	EXPECT_EQ(headers.get_header("X-CUSTOM")->get_value(), "1");
+}
+
+TEST_F(TestHttpHeaderTable,
+PreservesInsertionOrder) {
+	HttpHeaderTable headers;
+	headers.add_header("B", "1");
+	headers.add_header("Host", "localhost");
+	headers.add_header("A", "2");
+
+	std::vector<std::string> names;
+	for (const auto& header : headers)
+		names.push_back(header.get_name());
+
+	EXPECT_THAT(names, ElementsAre("B", "Host", "A"));
+}
+
+TEST_F(TestHttpHeaderTable,
+GrowBeyondInlineCapacity) {
+	HttpHeaderTable headers;
+	headers.add_header(HttpHeaderId::Host, "localhost");
+	for (std::size_t i = 0; i < 2 * HttpHeaderTable::InlineCapacity; ++i)
+		headers.add_header("X-Header-" + std::to_string(i), i);
+	headers.add_header(HttpHeaderId::ContentLength, 42);
+
+	EXPECT_EQ(headers.size(), 2 * HttpHeaderTable::InlineCapacity + 2);
+	EXPECT_EQ(headers.get_header(HttpHeaderId::Host)->get_value(), "localhost");
+	EXPECT_EQ(headers.get_header("x-header-0")->get_value(), "0");
+	EXPECT_EQ(headers.get_header("x-header-31")->get_value(), "31");
+	EXPECT_EQ(headers.get_header(HttpHeaderId::ContentLength)->get_value(), "42");
+
+	auto copy = headers;
+	auto moved = std::move(headers);
+	EXPECT_EQ(copy.size(), moved.size());
+	EXPECT_EQ(copy.get_header("x-header-17")->get_value(), "17");
+	EXPECT_EQ(moved.get_header(HttpHeaderId::Host)->get_value(), "localhost");
+}
+
+TEST_F(TestHttpHeaderTable,
+Clear) {
+	HttpHeaderTable headers;
+	headers.add_header("Host", "localhost");
+	headers.add_header("X-Custom", "value");
+	headers.clear();
+
+	EXPECT_EQ(headers.size(), 0u);
+	EXPECT_FALSE(headers.has_header(HttpHeaderId::Host));
+	EXPECT_FALSE(headers.has_header("X-Custom"));
+
+	headers.add_header("Host", "example");
+	EXPECT_EQ(headers.get_header(HttpHeaderId::Host)->get_value(), "example");
+}
+
+TEST_F(TestHttpHeaderTable,
+RemoveHeader) {
+	HttpHeaderTable table;
+	table.add_header("Content-Type", "text/plain");
+	table.add_header("X-Custom", "1");
+	table.add_header(HttpHeaderId::ContentLength, 10);
+
+	table.remove_header("x-custom");
+	table.remove_header("X-Missing");
+	EXPECT_EQ(table.size(), 2u);
+	EXPECT_FALSE(table.has_header("X-Custom"));
+	ASSERT_TRUE(table.get_header(HttpHeaderId::ContentLength));
+	EXPECT_EQ(table.get_header(HttpHeaderId::ContentLength)->get_value(), "10");
+
+	table.remove_header("Content-Type");
+	EXPECT_FALSE(table.has_header(HttpHeaderId::ContentType));
+	EXPECT_EQ(table.get_header(HttpHeaderId::ContentLength)->get_value(), "10");
+
+	table.add_header(HttpHeaderId::ContentType, "application/json");
+	EXPECT_EQ(table.get_header(HttpHeaderId::ContentType)->get_value(), "application/json");
+}
@@ -184,3 +184,70 @@ ParseByParts) {
 	EXPECT_EQ(request.get_header("content-length")->get_value_as<std::uint64_t>(), 5u);
 	EXPECT_EQ(request.get_content(), "Hello");
 }
+
+TEST_F(TestHttpRequestParser,
+ParseInvalidContentLength) {
+	StringStream stream(
+		"POST / HTTP/1.1\r\n"
+		"Content-Length: 12abc\r\n"
+		"\r\n"
+		"Hello World!"
+	);
+
+	HttpRequestParser parser;
+
+	EXPECT_THROW(parser.parse(stream), ParseError);
+}
+
+TEST_F(TestHttpRequestParser,
+ParsePipelinedRequests) {
+	using namespace std::literals;
+
+	StringStream stream(
+		"GET /first HTTP/1.1\r\n"
+		"\r\n"
+		"POST /second HTTP/1.1\r\n"
+		"Content-Length: 5\r\n"
+		"\r\n"
+		"Hello"
+		"GET /third HTTP/1.1\r\n"
+	);
+
+	HttpRequestParser parser;
+	EXPECT_TRUE(parser.is_idle());
+
+	auto first = parser.parse(stream);
+	ASSERT_TRUE(first);
+	EXPECT_EQ(first->get_resource(), "/first");
+	EXPECT_EQ(first->get_content(), "");
+
+	auto second = parser.parse(stream);
+	ASSERT_TRUE(second);
+	EXPECT_EQ(second->get_resource(), "/second");
+	EXPECT_EQ(second->get_content(), "Hello");
+
+	EXPECT_FALSE(parser.parse(stream));
+	EXPECT_FALSE(parser.is_idle());
+	EXPECT_FALSE(parser.is_reading_content());
+
+	stream.write_string("Content-Length: 3\r\n\r\n"sv);
+	EXPECT_FALSE(parser.parse(stream));
+	EXPECT_TRUE(parser.is_reading_content());
+}
+
+TEST_F(TestHttpRequestParser,
+ReceivedQueryIsKeptEncoded) {
+	StringStream stream(
+		"GET /x?q=a%20b&c=%7E HTTP/1.1\r\n"
+		"\r\n"
+	);
+
+	HttpRequestParser parser;
+
+	auto result = parser.parse(stream);
+	ASSERT_TRUE(result);
+	EXPECT_EQ(result->get_resource(), "/x");
+	EXPECT_EQ(result->dump(), "GET /x?q=a%20b&c=%7E HTTP/1.1\r\n\r\n");
+	ASSERT_TRUE(result->get_argument("q"));
+	EXPECT_EQ(result->get_argument("q")->get_value(), "a b");
+}
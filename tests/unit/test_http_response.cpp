@@ -0,0 +1,77 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <ulocal/http_response.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestHttpResponse : public ::testing::Test {};
+
+TEST_F(TestHttpResponse,
+StatusLines) {
+	EXPECT_EQ(get_status_line(200), "HTTP/1.1 200 OK\r\n");
+	EXPECT_EQ(get_status_line(404), "HTTP/1.1 404 Not Found\r\n");
+	EXPECT_EQ(get_status_line(505), "HTTP/1.1 505 HTTP Version Not Supported\r\n");
+	EXPECT_EQ(get_status_line(299), "");
+	EXPECT_EQ(get_status_line(-1), "");
+	EXPECT_EQ(get_status_line(1000), "");
+}
+
+TEST_F(TestHttpResponse,
+ReasonPhrases) {
+	EXPECT_EQ(get_reason_phrase(100), "Continue");
+	EXPECT_EQ(get_reason_phrase(200), "OK");
+	EXPECT_EQ(get_reason_phrase(503), "Service Unavailable");
+	EXPECT_EQ(get_reason_phrase(299), "Unknown");
+}
+
+TEST_F(TestHttpResponse,
+DumpKnownStatus) {
+	HttpResponse response{404, std::string{"Nope"}};
+	response.add_header("X-Custom", "value");
+	response.calculate_content_length();
+
+	EXPECT_EQ(response.dump(),
+		"HTTP/1.1 404 Not Found\r\n"
+		"X-Custom: value\r\n"
+		"Content-Length: 4\r\n"
+		"\r\n"
+		"Nope"
+	);
+}
+
+TEST_F(TestHttpResponse,
+DumpUnknownStatus) {
+	HttpResponse response{299};
+
+	EXPECT_EQ(response.get_reason(), "Unknown");
+	EXPECT_EQ(response.get_reason_view(), "Unknown");
+	EXPECT_EQ(response.dump(), "HTTP/1.1 299 Unknown\r\n\r\n");
+}
+
+TEST_F(TestHttpResponse,
+DumpCustomReason) {
+	HttpResponse response{200, std::string{"Fine"}, HttpHeaderTable{}, std::string{}};
+
+	EXPECT_EQ(response.get_reason(), "Fine");
+	EXPECT_EQ(response.get_reason_view(), "Fine");
+	EXPECT_EQ(response.dump(), "HTTP/1.1 200 Fine\r\n\r\n");
+}
+
+TEST_F(TestHttpResponse,
+DumpAnnouncesFileDescriptors) {
+	HttpResponse response{200, "abc"};
+	response.add_fd(FileDescriptor{::dup(STDOUT_FILENO)});
+	response.add_fd(FileDescriptor{::dup(STDOUT_FILENO)});
+	EXPECT_EQ(response.dump(), "HTTP/1.1 200 OK\r\nX-File-Descriptors: 2\r\n\r\nabc");
+
+	auto copy = response;
+	EXPECT_EQ(copy.get_fds().size(), 2u);
+	EXPECT_NE(copy.get_fds()[0].get(), response.get_fds()[0].get());
+
+	response.add_header(FileDescriptorsHeader, 2);
+	EXPECT_EQ(response.get_announced_fd_count(), 2u);
+	EXPECT_EQ(response.release_fds().size(), 2u);
+	EXPECT_TRUE(response.get_fds().empty());
+}
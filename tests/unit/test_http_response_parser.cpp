@@ -150,3 +150,15 @@ ParseByParts) {
 	EXPECT_EQ(response.get_content(), "Hello World!");
 
 }
+
+TEST_F(TestHttpResponseParser,
+ParseInvalidStatusCode) {
+	StringStream stream(
+		"HTTP/1.1 2x0 OK\r\n"
+		"\r\n"
+	);
+
+	HttpResponseParser parser;
+
+	EXPECT_THROW(parser.parse(stream), ParseError);
+}
@@ -0,0 +1,949 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <ulocal/http_client.hpp>
+#include <ulocal/http_server.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestHttpServer : public ::testing::Test
+{
+public:
+	TestHttpServer() : dir_template("/tmp/ulocal-test-XXXXXX"), socket_path(), server(), stopped(false), release(), released(release.get_future().share()), is_released(false)
+	{
+		::mkdtemp(dir_template);
+		socket_path = std::string{dir_template} + "/test.sock";
+		server = std::make_unique<HttpServer>(socket_path);
+
+		// Serving thread waits in this handler until resume() so everything which arrives in the meantime
+		// is handled in the same iteration of the event loop
+		server->endpoint({"GET"}, "/hold", [this](const HttpRequest&) {
+			released.wait();
+			return HttpResponse{200};
+		});
+	}
+
+	~TestHttpServer()
+	{
+		stop();
+		server.reset();
+		::unlink(socket_path.c_str());
+		::rmdir(dir_template);
+	}
+
+	std::future<HttpResponse> hold()
+	{
+		return submit("GET", "/hold");
+	}
+
+	void resume()
+	{
+		if (!is_released)
+		{
+			is_released = true;
+			release.set_value();
+		}
+	}
+
+	std::future<HttpResponse> submit(const std::string& method, const std::string& resource, HttpHeaderTable headers = {})
+	{
+		return server->submit(HttpRequest{method, resource, std::move(headers), std::string{}});
+	}
+
+	static HttpHeaderTable make_headers(const std::string& name, const std::string& value)
+	{
+		HttpHeaderTable result;
+		result.add_header(name, value);
+		return result;
+	}
+
+	// Reads until the server closes the connection
+	static std::string read_all(Socket<>& client)
+	{
+		pollfd fd = client.get_poll_fd();
+		while (::poll(&fd, 1, 1000) > 0 && client.read())
+			;
+		return std::string{client.get_stream().as_string_view()};
+	}
+
+	template <typename Predicate>
+	static bool wait_until(const Predicate& predicate)
+	{
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+		while (!predicate())
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+				return false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	}
+
+	DrainProgress shutdown(std::chrono::milliseconds timeout, std::function<void(const DrainProgress&)> progress = {})
+	{
+		resume();
+		stopped = true;
+		return server->shutdown(timeout, std::move(progress));
+	}
+
+	void stop()
+	{
+		resume();
+		if (!stopped)
+		{
+			stopped = true;
+			server->terminate();
+			server->wait_until_done();
+		}
+	}
+
+	char dir_template[32];
+	std::string socket_path;
+	std::unique_ptr<HttpServer> server;
+	bool stopped;
+	std::promise<void> release;
+	std::shared_future<void> released;
+	bool is_released;
+};
+
+TEST_F(TestHttpServer,
+OverloadedConnectionsAreRejected) {
+	HttpServerLimits limits;
+	limits.overload_connections = 2;
+	server->set_limits(limits);
+	server->endpoint({"GET"}, "/", [](const HttpRequest&) {
+		return HttpResponse{200};
+	});
+	server->serve();
+
+	std::vector<Socket<>> clients(2);
+	for (auto& client : clients)
+		client.connect(socket_path);
+	ASSERT_TRUE(wait_until([&]() { return server->get_metrics().active_connections == 2; }));
+
+	// Rejected connection gets 503 without sending anything
+	Socket<> rejected;
+	rejected.connect(socket_path);
+	EXPECT_THAT(read_all(rejected), StartsWith("HTTP/1.1 503 Service Unavailable\r\n"));
+	EXPECT_TRUE(wait_until([&]() { return server->get_metrics().rejected_connections == 1; }));
+
+	// Connections accepted before are served as usual
+	clients[0].write("GET / HTTP/1.1\r\n\r\n");
+	EXPECT_THAT(read_all(clients[0]), StartsWith("HTTP/1.1 200 OK\r\n"));
+
+	// Once there is room again, new connections are served
+	ASSERT_TRUE(wait_until([&]() { return server->get_metrics().active_connections == 1; }));
+	Socket<> accepted;
+	accepted.connect(socket_path);
+	accepted.write("GET / HTTP/1.1\r\n\r\n");
+	EXPECT_THAT(read_all(accepted), StartsWith("HTTP/1.1 200 OK\r\n"));
+	EXPECT_EQ(server->get_metrics().rejected_connections, 1u);
+}
+
+TEST_F(TestHttpServer,
+ConnectionsOverLimitWaitInBacklog) {
+	HttpServerLimits limits;
+	limits.max_connections = 1;
+	server->set_limits(limits);
+	server->endpoint({"GET"}, "/", [](const HttpRequest&) {
+		return HttpResponse{200};
+	});
+	server->serve();
+
+	Socket<> first;
+	first.connect(socket_path);
+	ASSERT_TRUE(wait_until([&]() { return server->get_metrics().accepted_connections == 1; }));
+
+	Socket<> second;
+	second.connect(socket_path);
+	second.write("GET / HTTP/1.1\r\n\r\n");
+	pollfd fd = second.get_poll_fd();
+	EXPECT_EQ(::poll(&fd, 1, 100), 0);
+	EXPECT_EQ(server->get_metrics().accepted_connections, 1u);
+
+	// Waiting connection is accepted once the first one is closed
+	first.close();
+	EXPECT_THAT(read_all(second), StartsWith("HTTP/1.1 200 OK\r\n"));
+	EXPECT_EQ(server->get_metrics().accepted_connections, 2u);
+	EXPECT_EQ(server->get_metrics().rejected_connections, 0u);
+}
+
+TEST_F(TestHttpServer,
+DescriptorExhaustionPausesAccepting) {
+	HttpServerLimits limits;
+	limits.accept_backoff = std::chrono::milliseconds(50);
+	server->set_limits(limits);
+	server->endpoint({"GET"}, "/", [](const HttpRequest&) {
+		return HttpResponse{200};
+	});
+	server->serve();
+
+	// Client socket is created before the limit is lowered, the server can't open any descriptor after that
+	Socket<> client;
+	int lowest_free_fd = ::dup(client.get_fd());
+	::close(lowest_free_fd);
+	rlimit original, lowered;
+	ASSERT_EQ(::getrlimit(RLIMIT_NOFILE, &original), 0);
+	lowered = original;
+	lowered.rlim_cur = lowest_free_fd;
+	ASSERT_EQ(::setrlimit(RLIMIT_NOFILE, &lowered), 0);
+
+	client.connect(socket_path);
+	client.write("GET / HTTP/1.1\r\n\r\n");
+	bool rejected = wait_until([&]() { return server->get_metrics().rejected_connections > 0; });
+	::setrlimit(RLIMIT_NOFILE, &original);
+	ASSERT_TRUE(rejected);
+	EXPECT_EQ(server->get_metrics().accepted_connections, 0u);
+
+	// Connection waits in the backlog and is served once the server accepts again
+	EXPECT_THAT(read_all(client), StartsWith("HTTP/1.1 200 OK\r\n"));
+	EXPECT_EQ(server->get_metrics().accepted_connections, 1u);
+}
+
+TEST_F(TestHttpServer,
+IncompleteHeadersTimeOut) {
+	HttpServerTimeouts timeouts;
+	timeouts.header = std::chrono::milliseconds(100);
+	server->set_timeouts(timeouts);
+	server->serve();
+
+	auto start = std::chrono::steady_clock::now();
+	Socket<> client;
+	client.connect(socket_path);
+	client.write("GET / HTTP/1.1\r\nHost: ");
+	EXPECT_EQ(read_all(client), "");
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+	EXPECT_TRUE(wait_until([&]() { return server->get_metrics().timed_out_connections == 1; }));
+}
+
+TEST_F(TestHttpServer,
+IdleKeepAliveConnectionTimesOut) {
+	HttpServerTimeouts timeouts;
+	timeouts.idle = std::chrono::milliseconds(100);
+	server->set_timeouts(timeouts);
+	server->set_keep_alive(true);
+	server->endpoint({"GET"}, "/", [](const HttpRequest&) {
+		return HttpResponse{200};
+	});
+	server->serve();
+
+	Socket<> client;
+	client.connect(socket_path);
+	client.write("GET / HTTP/1.1\r\nConnection: keep-alive\r\n\r\n");
+	auto start = std::chrono::steady_clock::now();
+	auto response = read_all(client);
+	EXPECT_THAT(response, StartsWith("HTTP/1.1 200 OK\r\n"));
+	EXPECT_THAT(response, HasSubstr("Connection: keep-alive\r\n"));
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+	EXPECT_TRUE(wait_until([&]() { return server->get_metrics().timed_out_connections == 1; }));
+}
+
+TEST_F(TestHttpServer,
+ActiveKeepAliveConnectionStaysOpen) {
+	HttpServerTimeouts timeouts;
+	timeouts.header = std::chrono::milliseconds(150);
+	timeouts.idle = std::chrono::milliseconds(150);
+	server->set_timeouts(timeouts);
+	server->set_keep_alive(true);
+	server->endpoint({"GET"}, "/", [](const HttpRequest&) {
+		return HttpResponse{200, "ok"};
+	});
+	server->serve();
+
+	// Every part arrives within its deadline while the connection as a whole lives much longer than any of them
+	Socket<> client;
+	client.connect(socket_path);
+	auto start = std::chrono::steady_clock::now();
+	for (std::size_t i = 1; i <= 6; ++i)
+	{
+		client.write("GET / HTTP/1.1\r\n");
+		std::this_thread::sleep_for(std::chrono::milliseconds(25));
+		client.write("Connection: keep-alive\r\n\r\n");
+
+		pollfd fd = client.get_poll_fd();
+		auto answered = [&]() {
+			auto data = client.get_stream().as_string_view();
+			std::size_t count = 0;
+			for (auto pos = data.find("\r\n\r\nok"); pos != std::string_view::npos; pos = data.find("\r\n\r\nok", pos + 1))
+				++count;
+			return count;
+		};
+		while (answered() < i && ::poll(&fd, 1, 1000) > 0)
+			ASSERT_TRUE(client.read());
+		ASSERT_EQ(answered(), i);
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(300));
+	EXPECT_EQ(server->get_metrics().timed_out_connections, 0u);
+	EXPECT_EQ(server->get_metrics().accepted_connections, 1u);
+}
+
+TEST_F(TestHttpServer,
+PeerFilterRejectsOtherUsers) {
+	std::atomic<bool> called{false};
+	server->set_peer_filter(PeerFilter{{::getuid() + 1}, {}});
+	server->endpoint({"GET"}, "/", [&](const HttpRequest&) {
+		called = true;
+		return HttpResponse{200};
+	});
+	server->serve();
+
+	Socket<> client;
+	client.connect(socket_path);
+	client.write("GET / HTTP/1.1\r\n\r\n");
+	EXPECT_THAT(read_all(client), StartsWith("HTTP/1.1 403 Forbidden\r\n"));
+	EXPECT_TRUE(wait_until([&]() { return server->get_metrics().unauthorized_connections == 1; }));
+	EXPECT_EQ(server->get_metrics().accepted_connections, 0u);
+	EXPECT_FALSE(called);
+}
+
+TEST_F(TestHttpServer,
+PeerFilterAllowsListedUser) {
+	server->set_peer_filter(PeerFilter{{::getuid() + 1, ::getuid()}, {}});
+	server->endpoint({"GET"}, "/", [](const HttpRequest&) {
+		return HttpResponse{200};
+	});
+	server->serve();
+
+	Socket<> client;
+	client.connect(socket_path);
+	client.write("GET / HTTP/1.1\r\n\r\n");
+	EXPECT_THAT(read_all(client), StartsWith("HTTP/1.1 200 OK\r\n"));
+	EXPECT_EQ(server->get_metrics().unauthorized_connections, 0u);
+}
+
+TEST_F(TestHttpServer,
+HandlerSeesPeerCredentials) {
+	server->endpoint({"GET"}, "/", [](const HttpRequest& request) {
+		const auto& credentials = request.get_peer_credentials();
+		if (!credentials)
+			return HttpResponse{500};
+		return HttpResponse{200, std::to_string(credentials->pid) + " " + std::to_string(credentials->uid) + " " + std::to_string(credentials->gid)};
+	});
+	server->serve();
+
+	Socket<> client;
+	client.connect(socket_path);
+	client.write("GET / HTTP/1.1\r\n\r\n");
+	auto response = read_all(client);
+	EXPECT_THAT(response, StartsWith("HTTP/1.1 200 OK\r\n"));
+	EXPECT_THAT(response, EndsWith("\r\n\r\n" + std::to_string(::getpid()) + " " + std::to_string(::getuid()) + " " + std::to_string(::getgid())));
+}
+
+TEST_F(TestHttpServer,
+ListenersHaveTheirOwnRoutes) {
+	// Abstract socket doesn't leave any file behind, the directory only makes the name unique
+	auto abstract_path = "@" + std::string{dir_template} + "/abstract.sock";
+	auto abstract = server->add_listener(abstract_path);
+	server->endpoint({"GET"}, "/file", [](const HttpRequest&) {
+		return HttpResponse{200, "file"};
+	});
+	server->endpoint(abstract, {"GET"}, "/abstract", [](const HttpRequest&) {
+		return HttpResponse{200, "abstract"};
+	});
+	server->serve();
+
+	HttpClient file_client{socket_path};
+	HttpClient abstract_client{abstract_path};
+	EXPECT_EQ(file_client.send_request("GET", "/file").get_content(), "file");
+	EXPECT_EQ(file_client.send_request("GET", "/abstract").get_status_code(), 404);
+	EXPECT_EQ(abstract_client.send_request("GET", "/abstract").get_content(), "abstract");
+	EXPECT_EQ(abstract_client.send_request("GET", "/file").get_status_code(), 404);
+}
+
+#if defined(ULOCAL_TRACING)
+TEST_F(TestHttpServer,
+RequestLifecycleIsTraced) {
+	TraceRingBuffer trace;
+	server->set_trace_sink(&trace);
+	server->endpoint({"GET"}, "/", [](const HttpRequest&) {
+		return HttpResponse{200};
+	});
+	server->serve();
+
+	Socket<> client;
+	client.connect(socket_path);
+	client.write("GET / HTTP/1.1\r\n\r\n");
+	EXPECT_THAT(read_all(client), StartsWith("HTTP/1.1 200 OK\r\n"));
+
+	// Number of reads depends on how the request arrives so they are left out
+	auto get_events = [&]() {
+		std::vector<TraceRecord> result;
+		for (const auto& record : trace.get_records())
+		{
+			if (record.event != TraceEvent::ReadComplete)
+				result.push_back(record);
+		}
+		return result;
+	};
+	ASSERT_TRUE(wait_until([&]() {
+		auto events = get_events();
+		return !events.empty() && events.back().event == TraceEvent::Close;
+	}));
+
+	auto events = get_events();
+	std::vector<TraceEvent> sequence;
+	for (const auto& record : events)
+		sequence.push_back(record.event);
+	EXPECT_THAT(sequence, ElementsAre(
+		TraceEvent::Accept,
+		TraceEvent::RequestParsed,
+		TraceEvent::RouteResolved,
+		TraceEvent::HandlerStart,
+		TraceEvent::HandlerEnd,
+		TraceEvent::ResponseSerialized,
+		TraceEvent::WriteComplete,
+		TraceEvent::Close
+	));
+
+	// Connection events aren't tied to any request while all the others belong to the only one
+	ASSERT_EQ(events.size(), 8u);
+	EXPECT_EQ(events.front().request_id, 0u);
+	EXPECT_EQ(events.back().request_id, 0u);
+	for (std::size_t i = 1; i + 1 < events.size(); ++i)
+	{
+		EXPECT_EQ(events[i].connection_id, events.front().connection_id);
+		EXPECT_EQ(events[i].request_id, events[1].request_id);
+		EXPECT_NE(events[i].request_id, 0u);
+		EXPECT_GE(events[i].timestamp_ns, events[i - 1].timestamp_ns);
+	}
+}
+#endif
+
+TEST_F(TestHttpServer,
+ShutdownWaitsForStartedRequests) {
+	server->endpoint({"GET"}, "/", [](const HttpRequest&) {
+		return HttpResponse{200, "done"};
+	});
+	server->serve();
+
+	Socket<> idle, busy;
+	idle.connect(socket_path);
+	busy.connect(socket_path);
+	busy.write("GET / HTTP/1.1\r\n");
+	ASSERT_TRUE(wait_until([&]() { return server->get_metrics().bytes_in > 0 && server->get_metrics().active_connections == 2; }));
+
+	std::vector<DrainProgress> reports;
+	auto result = std::async(std::launch::async, [&]() {
+		return shutdown(std::chrono::seconds(5), [&](const DrainProgress& progress) { reports.push_back(progress); });
+	});
+
+	// Idle connection is closed right away while the busy one can still finish its request
+	EXPECT_EQ(read_all(idle), "");
+	busy.write("\r\n");
+	auto response = read_all(busy);
+	EXPECT_THAT(response, StartsWith("HTTP/1.1 200 OK\r\n"));
+	EXPECT_THAT(response, EndsWith("done"));
+
+	auto progress = result.get();
+	EXPECT_TRUE(progress.done);
+	EXPECT_EQ(progress.open_connections, 0u);
+	EXPECT_EQ(progress.closed_connections, 2u);
+	EXPECT_EQ(progress.forced_connections, 0u);
+
+	ASSERT_THAT(reports, Not(IsEmpty()));
+	EXPECT_TRUE(reports.back().done);
+	for (std::size_t i = 1; i < reports.size(); ++i)
+		EXPECT_LT(reports[i].open_connections, reports[i - 1].open_connections);
+}
+
+TEST_F(TestHttpServer,
+ShutdownClosesConnectionsAtDeadline) {
+	server->serve();
+
+	Socket<> busy;
+	busy.connect(socket_path);
+	busy.write("GET / HTTP/1.1\r\n");
+	ASSERT_TRUE(wait_until([&]() { return server->get_metrics().bytes_in > 0; }));
+
+	auto start = std::chrono::steady_clock::now();
+	auto progress = shutdown(std::chrono::milliseconds(100));
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+	EXPECT_TRUE(progress.done);
+	EXPECT_EQ(progress.closed_connections, 0u);
+	EXPECT_EQ(progress.forced_connections, 1u);
+
+	// Unfinished request is never answered
+	EXPECT_EQ(read_all(busy), "");
+}
+
+TEST_F(TestHttpServer,
+ShutdownOfStoppedServer) {
+	auto progress = shutdown(std::chrono::milliseconds(100));
+	EXPECT_TRUE(progress.done);
+	EXPECT_EQ(progress.open_connections, 0u);
+}
+
+TEST_F(TestHttpServer,
+LoopbackRoundTrip) {
+	server->endpoint({"POST"}, "/echo", [](const HttpRequest& request) {
+		return HttpResponse{200, request.get_content() + std::string{request.get_argument("suffix")->get_value()}};
+	});
+	server->serve();
+
+	HttpClient client{*server};
+	auto response = client.send_request("POST", "/echo?suffix=!", std::string{"hello"});
+	EXPECT_EQ(response.get_status_code(), 200);
+	EXPECT_EQ(response.get_content(), "hello!");
+	EXPECT_EQ(client.send_request("GET", "/missing").get_status_code(), 404);
+}
+
+TEST_F(TestHttpServer,
+LoopbackToStoppedServer) {
+	HttpClient client{*server};
+	EXPECT_THROW(client.send_request("GET", "/"), SocketError);
+
+	server->serve();
+	stop();
+	EXPECT_THROW(client.send_request("GET", "/"), SocketError);
+}
+
+TEST_F(TestHttpServer,
+LoopbackFromServingThread) {
+	server->endpoint({"GET"}, "/inner", [](const HttpRequest&) {
+		return HttpResponse{200, "inner"};
+	});
+	server->endpoint({"GET"}, "/outer", [this](const HttpRequest&) {
+		// Server can't answer the inner request while it waits in the handler of the outer one
+		HttpClient client{*server};
+		try
+		{
+			client.send_request("GET", "/inner");
+			return HttpResponse{200};
+		}
+		catch (const SocketError&)
+		{
+			return HttpResponse{500};
+		}
+	});
+	server->serve();
+
+	HttpClient client{*server};
+	EXPECT_EQ(client.send_request("GET", "/outer").get_status_code(), 500);
+	EXPECT_EQ(client.send_request("GET", "/inner").get_content(), "inner");
+}
+
+TEST_F(TestHttpServer,
+ConcurrentLoopbackRequestsWhileStopping) {
+	std::atomic<int> handled{0};
+	server->endpoint({"GET"}, "/", [&](const HttpRequest&) {
+		++handled;
+		return HttpResponse{200};
+	});
+	server->serve();
+
+	// Every request is either answered or fails, none of them may be left waiting for a response forever
+	std::atomic<int> answered{0}, failed{0};
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 8; ++i)
+	{
+		threads.emplace_back([&]() {
+			HttpClient client{*server};
+			for (int j = 0; j < 200; ++j)
+			{
+				try
+				{
+					client.send_request("GET", "/");
+					++answered;
+				}
+				catch (const SocketError&)
+				{
+					++failed;
+				}
+			}
+		});
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	stop();
+	for (auto& thread : threads)
+		thread.join();
+
+	EXPECT_EQ(answered + failed, 8 * 200);
+	EXPECT_EQ(answered, handled);
+}
+
+TEST_F(TestHttpServer,
+IdenticalRequestsShareHandlerCall) {
+	int calls = 0;
+	server->endpoint({"GET", "POST"}, "/data", [&](const HttpRequest& request) {
+		++calls;
+		return HttpResponse{200, std::to_string(calls) + request.get_method()};
+	});
+	server->coalesce_endpoint("/data", {"X-Key"});
+	server->serve();
+
+	auto held = hold();
+	std::vector<std::future<HttpResponse>> same;
+	for (int i = 0; i < 4; ++i)
+		same.push_back(submit("GET", "/data?a=1&b=2"));
+	// Order of arguments doesn't matter
+	same.push_back(submit("GET", "/data?b=2&a=1"));
+	auto key1 = submit("GET", "/data?a=1&b=2", make_headers("X-Key", "1"));
+	auto key2 = submit("GET", "/data?a=1&b=2", make_headers("x-key", "2"));
+	auto post = submit("POST", "/data?a=1&b=2");
+	auto other_args = submit("GET", "/data?a=2&b=2");
+	resume();
+	held.get();
+
+	std::vector<std::string> contents;
+	for (auto& response : same)
+		contents.push_back(response.get().get_content());
+	EXPECT_THAT(contents, Each(Eq("1GET")));
+	EXPECT_EQ(key1.get().get_content(), "2GET");
+	EXPECT_EQ(key2.get().get_content(), "3GET");
+	EXPECT_EQ(post.get().get_content(), "4POST");
+	EXPECT_EQ(other_args.get().get_content(), "5GET");
+	EXPECT_EQ(server->get_metrics().coalesced_requests, 4u);
+}
+
+TEST_F(TestHttpServer,
+AcceptEncodingSplitsOnlyCompressedRoutes) {
+	int calls = 0;
+	auto handler = [&](const HttpRequest&) {
+		++calls;
+		return HttpResponse{200, std::to_string(calls)};
+	};
+	server->endpoint({"GET"}, "/plain", handler);
+	server->endpoint({"GET"}, "/compressed", handler);
+	server->coalesce_endpoint("/plain");
+	server->coalesce_endpoint("/compressed");
+	server->compress_endpoint("/compressed");
+	server->serve();
+
+	auto held = hold();
+	auto plain1 = submit("GET", "/plain");
+	auto plain2 = submit("GET", "/plain", make_headers("Accept-Encoding", "gzip"));
+	auto compressed1 = submit("GET", "/compressed");
+	auto compressed2 = submit("GET", "/compressed", make_headers("Accept-Encoding", "gzip"));
+	auto compressed3 = submit("GET", "/compressed", make_headers("Accept-Encoding", "gzip"));
+	resume();
+	held.get();
+
+	EXPECT_EQ(plain1.get().get_content(), "1");
+	EXPECT_EQ(plain2.get().get_content(), "1");
+	EXPECT_EQ(compressed1.get().get_content(), "2");
+	EXPECT_EQ(compressed2.get().get_content(), "3");
+	EXPECT_EQ(compressed3.get().get_content(), "3");
+	EXPECT_EQ(server->get_metrics().coalesced_requests, 2u);
+}
+
+TEST_F(TestHttpServer,
+CoalescedResponsesWithFileDescriptors) {
+	int calls = 0;
+	server->endpoint({"GET"}, "/fd", [&](const HttpRequest&) {
+		++calls;
+		HttpResponse response{200};
+		response.add_fd(FileDescriptor{::dup(STDERR_FILENO)});
+		return response;
+	});
+	server->coalesce_endpoint("/fd");
+	server->serve();
+
+	auto held = hold();
+	auto response1 = submit("GET", "/fd");
+	auto response2 = submit("GET", "/fd");
+	resume();
+	held.get();
+
+	auto fds1 = response1.get().release_fds();
+	auto fds2 = response2.get().release_fds();
+	EXPECT_EQ(calls, 1);
+	ASSERT_EQ(fds1.size(), 1u);
+	ASSERT_EQ(fds2.size(), 1u);
+	EXPECT_TRUE(fds1[0].is_valid());
+	EXPECT_TRUE(fds2[0].is_valid());
+	EXPECT_NE(fds1[0].get(), fds2[0].get());
+}
+
+TEST_F(TestHttpServer,
+CoalescedResponsesOverSocket) {
+	std::atomic<int> calls{0};
+	server->endpoint({"GET"}, "/data", [&](const HttpRequest&) {
+		++calls;
+		return HttpResponse{200, "shared"};
+	});
+	server->coalesce_endpoint("/data");
+	server->serve();
+
+	// Requests of all clients are already waiting in their sockets once the serving thread gets to them
+	auto held = hold();
+	std::vector<Socket<>> clients(4);
+	for (auto& client : clients)
+	{
+		client.connect(socket_path);
+		client.write("GET /data HTTP/1.1\r\n\r\n");
+	}
+	resume();
+	held.get();
+
+	for (auto& client : clients)
+	{
+		auto response = read_all(client);
+		EXPECT_THAT(response, StartsWith("HTTP/1.1 200 OK\r\n"));
+		EXPECT_THAT(response, EndsWith("\r\n\r\nshared"));
+	}
+
+	EXPECT_EQ(calls, 1);
+	EXPECT_EQ(server->get_metrics().coalesced_requests, 3u);
+}
+
+TEST_F(TestHttpServer,
+CachedResponses) {
+	int calls = 0;
+	server->endpoint({"GET"}, "/data", [&](const HttpRequest& request) {
+		++calls;
+		return HttpResponse{request.get_argument("missing") ? 404 : 200, std::to_string(calls)};
+	});
+	server->set_response_cache(1 << 20);
+	server->cache_endpoint("/data", std::chrono::seconds(60), {"X-Key"});
+	server->serve();
+
+	HttpClient client{*server};
+	EXPECT_EQ(client.send_request("GET", "/data?a=1&b=2").get_content(), "1");
+	EXPECT_EQ(client.send_request("GET", "/data?b=2&a=1").get_content(), "1");
+	EXPECT_EQ(server->get_metrics().cache_misses, 1u);
+	EXPECT_EQ(server->get_metrics().cache_hits, 1u);
+
+	// Key headers and arguments make a different entry
+	EXPECT_EQ(submit("GET", "/data?a=1&b=2", make_headers("X-Key", "1")).get().get_content(), "2");
+	EXPECT_EQ(submit("GET", "/data?a=1&b=2", make_headers("X-Key", "1")).get().get_content(), "2");
+	EXPECT_EQ(client.send_request("GET", "/data?a=2").get_content(), "3");
+	// Headers which are not keys don't
+	EXPECT_EQ(submit("GET", "/data?a=1&b=2", make_headers("X-Other", "1")).get().get_content(), "1");
+
+	// Only successful responses are cached
+	EXPECT_EQ(client.send_request("GET", "/data?missing=1").get_content(), "4");
+	EXPECT_EQ(client.send_request("GET", "/data?missing=1").get_content(), "5");
+	EXPECT_EQ(client.send_request("POST", "/data?a=1&b=2").get_status_code(), 405);
+
+	EXPECT_EQ(server->invalidate_cache("/data"), 3u);
+	EXPECT_EQ(client.send_request("GET", "/data?a=1&b=2").get_content(), "6");
+	EXPECT_EQ(calls, 6);
+
+	auto metrics = server->get_metrics();
+	EXPECT_EQ(metrics.cache_hits, 3u);
+	EXPECT_EQ(metrics.cache_misses, 6u);
+	EXPECT_THAT(metrics.to_prometheus(), HasSubstr("ulocal_cache_hits_total 3\n"));
+}
+
+TEST_F(TestHttpServer,
+CachedResponsesOverSocket) {
+	std::atomic<int> calls{0};
+	server->endpoint({"GET"}, "/data", [&](const HttpRequest&) {
+		++calls;
+		return HttpResponse{200, "cached"};
+	});
+	server->set_response_cache(1 << 20);
+	server->cache_endpoint("/data", std::chrono::milliseconds(50));
+	server->serve();
+
+	HttpClient client{socket_path};
+	EXPECT_EQ(client.send_request("GET", "/data").get_content(), "cached");
+	EXPECT_EQ(client.send_request("GET", "/data").get_content(), "cached");
+	EXPECT_EQ(calls, 1);
+
+	// Expired responses are not used anymore
+	std::this_thread::sleep_for(std::chrono::milliseconds(60));
+	EXPECT_EQ(client.send_request("GET", "/data").get_content(), "cached");
+	EXPECT_EQ(calls, 2);
+	EXPECT_EQ(server->get_metrics().cache_hits, 1u);
+}
+
+TEST_F(TestHttpServer,
+ConditionalEndpoint) {
+	int calls = 0;
+	std::string version = "1";
+	auto modified = std::chrono::system_clock::from_time_t(784111777);
+	server->conditional_endpoint({"GET"}, "/doc", [&](const HttpRequest&) {
+		return ResponseValidator{version, false, modified};
+	}, [&](const HttpRequest&) {
+		++calls;
+		return HttpResponse{200, "doc" + version};
+	});
+	server->serve();
+
+	auto response = submit("GET", "/doc").get();
+	EXPECT_EQ(response.get_status_code(), 200);
+	EXPECT_EQ(response.get_header(HttpHeaderId::ETag)->get_value(), "\"1\"");
+	EXPECT_EQ(response.get_header(HttpHeaderId::LastModified)->get_value(), "Sun, 06 Nov 1994 08:49:37 GMT");
+	EXPECT_EQ(calls, 1);
+
+	// Handler is not called at all when the client has the current representation
+	response = submit("GET", "/doc", make_headers("If-None-Match", "\"0\", \"1\"")).get();
+	EXPECT_EQ(response.get_status_code(), 304);
+	EXPECT_EQ(response.get_content(), "");
+	EXPECT_EQ(response.get_header(HttpHeaderId::ETag)->get_value(), "\"1\"");
+	response = submit("GET", "/doc", make_headers("If-Modified-Since", "Sun, 06 Nov 1994 08:49:37 GMT")).get();
+	EXPECT_EQ(response.get_status_code(), 304);
+	EXPECT_EQ(calls, 1);
+
+	response = submit("GET", "/doc", make_headers("If-None-Match", "\"0\"")).get();
+	EXPECT_EQ(response.get_status_code(), 200);
+	EXPECT_EQ(response.get_content(), "doc1");
+	EXPECT_EQ(calls, 2);
+}
+
+TEST_F(TestHttpServer,
+ClientValidatorCache) {
+	std::atomic<int> calls{0}, version{1};
+	server->conditional_endpoint({"GET"}, "/doc", [&](const HttpRequest&) {
+		return ResponseValidator{std::to_string(version), false, std::nullopt};
+	}, [&](const HttpRequest&) {
+		++calls;
+		return HttpResponse{200, "doc" + std::to_string(version)};
+	});
+	server->serve();
+
+	HttpClient client{socket_path};
+	client.set_validator_cache_size(4);
+	EXPECT_EQ(client.send_request("GET", "/doc").get_content(), "doc1");
+
+	// 304 from the server is answered by the remembered response
+	auto response = client.send_request("GET", "/doc");
+	EXPECT_EQ(response.get_status_code(), 200);
+	EXPECT_EQ(response.get_content(), "doc1");
+	EXPECT_EQ(calls, 1);
+
+	version = 2;
+	EXPECT_EQ(client.send_request("GET", "/doc").get_content(), "doc2");
+	EXPECT_EQ(client.send_request("GET", "/doc").get_content(), "doc2");
+	EXPECT_EQ(calls, 2);
+
+	// Without the cache every request is sent unconditionally
+	client.set_validator_cache_size(0);
+	EXPECT_EQ(client.send_request("GET", "/doc").get_content(), "doc2");
+	EXPECT_EQ(calls, 3);
+}
+
+#ifdef ULOCAL_COMPRESSION
+TEST_F(TestHttpServer,
+CompressedResponsesHaveWeakEtag) {
+	server->conditional_endpoint({"GET"}, "/doc", [](const HttpRequest&) {
+		return ResponseValidator{"1", false, std::nullopt};
+	}, [](const HttpRequest&) {
+		return HttpResponse{200, std::string(2048, 'x')};
+	});
+	server->compress_endpoint("/doc");
+	server->serve();
+
+	auto response = submit("GET", "/doc").get();
+	EXPECT_FALSE(response.has_header(HttpHeaderId::ContentEncoding));
+	EXPECT_EQ(response.get_header(HttpHeaderId::ETag)->get_value(), "\"1\"");
+
+	response = submit("GET", "/doc", make_headers("Accept-Encoding", "gzip")).get();
+	EXPECT_EQ(response.get_header(HttpHeaderId::ContentEncoding)->get_value(), "gzip");
+	EXPECT_EQ(response.get_header(HttpHeaderId::ETag)->get_value(), "W/\"1\"");
+
+	// Weak tag of the encoded representation is still recognized and 304 carries the same tag
+	HttpHeaderTable headers;
+	headers.add_header("Accept-Encoding", "gzip");
+	headers.add_header("If-None-Match", "W/\"1\"");
+	response = submit("GET", "/doc", std::move(headers)).get();
+	EXPECT_EQ(response.get_status_code(), 304);
+	EXPECT_EQ(response.get_header(HttpHeaderId::ETag)->get_value(), "W/\"1\"");
+}
+#endif
+
+#ifdef ULOCAL_COMPRESSION
+TEST_F(TestHttpServer,
+CompressedEndpoint) {
+	std::string content(4096, 'a');
+	server->endpoint({"GET"}, "/big", [&](const HttpRequest&) { return HttpResponse{200, content}; });
+	server->endpoint({"GET"}, "/plain", [&](const HttpRequest&) { return HttpResponse{200, content}; });
+	server->endpoint({"GET"}, "/small", [](const HttpRequest&) { return HttpResponse{200, "small"}; });
+	server->endpoint({"GET"}, "/empty", [](const HttpRequest&) { return HttpResponse{204}; });
+	server->conditional_endpoint({"GET"}, "/doc", [](const HttpRequest&) {
+		return ResponseValidator{"1", false, std::nullopt};
+	}, [&](const HttpRequest&) {
+		return HttpResponse{200, content};
+	});
+	for (auto route : {"/big", "/small", "/empty", "/doc"})
+		server->compress_endpoint(route);
+	server->serve();
+
+	auto get = [&](const std::string& route, const std::string& accept_encoding) {
+		return submit("GET", route, accept_encoding.empty() ? HttpHeaderTable{} : make_headers("Accept-Encoding", accept_encoding)).get();
+	};
+	auto get_encoding = [](const HttpResponse& response) {
+		auto header = response.get_header(HttpHeaderId::ContentEncoding);
+		return header ? header->get_value() : std::string{"identity"};
+	};
+
+	auto response = get("/big", "gzip, deflate");
+	EXPECT_EQ(get_encoding(response), "gzip");
+	EXPECT_EQ(response.get_header(HttpHeaderId::Vary)->get_value(), "Accept-Encoding");
+	EXPECT_LT(response.get_content().length(), content.length());
+	EXPECT_EQ(decompress(response.get_content(), ContentEncoding::Gzip), content);
+
+	response = get("/big", "gzip;q=0.5, deflate");
+	EXPECT_EQ(get_encoding(response), "deflate");
+	EXPECT_EQ(decompress(response.get_content(), ContentEncoding::Deflate), content);
+
+	// Representation depends on Accept-Encoding even if it ends up not encoded
+	for (auto accept_encoding : {"", "br", "gzip;q=0"})
+	{
+		response = get("/big", accept_encoding);
+		EXPECT_EQ(get_encoding(response), "identity");
+		EXPECT_EQ(response.get_header(HttpHeaderId::Vary)->get_value(), "Accept-Encoding");
+		EXPECT_EQ(response.get_content(), content);
+	}
+	response = get("/small", "gzip");
+	EXPECT_EQ(get_encoding(response), "identity");
+	EXPECT_TRUE(response.has_header(HttpHeaderId::Vary));
+
+	response = get("/plain", "gzip");
+	EXPECT_EQ(get_encoding(response), "identity");
+	EXPECT_FALSE(response.has_header(HttpHeaderId::Vary));
+
+	// Responses without content are left alone
+	response = get("/empty", "gzip");
+	EXPECT_EQ(response.get_status_code(), 204);
+	EXPECT_EQ(get_encoding(response), "identity");
+	EXPECT_FALSE(response.has_header(HttpHeaderId::Vary));
+
+	HttpHeaderTable headers;
+	headers.add_header("Accept-Encoding", "gzip");
+	headers.add_header("If-None-Match", "\"1\"");
+	response = submit("GET", "/doc", std::move(headers)).get();
+	EXPECT_EQ(response.get_status_code(), 304);
+	EXPECT_EQ(get_encoding(response), "identity");
+	EXPECT_FALSE(response.has_header(HttpHeaderId::Vary));
+	EXPECT_EQ(response.get_content(), "");
+}
+
+TEST_F(TestHttpServer,
+ClientDecompressesResponses) {
+	std::string content(4096, 'a');
+	server->endpoint({"GET"}, "/big", [&](const HttpRequest&) { return HttpResponse{200, content}; });
+	server->compress_endpoint("/big");
+	server->serve();
+
+	HttpClient client{socket_path};
+	auto response = client.send_request("GET", "/big");
+	EXPECT_EQ(response.get_content(), content);
+	EXPECT_FALSE(response.has_header(HttpHeaderId::ContentEncoding));
+	// Compressed response went through the socket
+	ASSERT_TRUE(wait_until([&]() { return server->get_metrics().bytes_out > 0; }));
+	EXPECT_LT(server->get_metrics().bytes_out, content.length());
+
+	// Content which would expand over the limit is rejected
+	client.set_max_content_length(content.length() - 1);
+	EXPECT_THROW(client.send_request("GET", "/big"), RequestError);
+
+	// Loopback requests are not compressed at all
+	HttpClient loopback_client{*server};
+	loopback_client.set_max_content_length(content.length());
+	EXPECT_EQ(loopback_client.send_request("GET", "/big").get_content(), content);
+}
+#endif
@@ -0,0 +1,93 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+
+#include <ulocal/key_value.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestKeyValue : public ::testing::Test {};
+
+TEST_F(TestKeyValue,
+SetIntegers) {
+	EXPECT_EQ(KeyValue("a", 0).get_value(), "0");
+	EXPECT_EQ(KeyValue("a", -42).get_value(), "-42");
+	EXPECT_EQ(KeyValue("a", std::numeric_limits<std::uint64_t>::max()).get_value(), "18446744073709551615");
+	EXPECT_EQ(KeyValue("a", std::numeric_limits<std::int64_t>::min()).get_value(), "-9223372036854775808");
+}
+
+TEST_F(TestKeyValue,
+SetFloatingPoint) {
+	EXPECT_EQ(KeyValue("a", 0.5).get_value(), "0.5");
+	EXPECT_EQ(KeyValue("a", -1.25f).get_value(), "-1.25");
+}
+
+TEST_F(TestKeyValue,
+SetOther) {
+	using namespace std::literals;
+
+	EXPECT_EQ(KeyValue("a", true).get_value(), "true");
+	EXPECT_EQ(KeyValue("a", "str").get_value(), "str");
+	EXPECT_EQ(KeyValue("a", "view"sv).get_value(), "view");
+
+	KeyValue kv("a", 1);
+	kv.set_value(123456789);
+	EXPECT_EQ(kv.get_value(), "123456789");
+}
+
+TEST_F(TestKeyValue,
+SetValueReusesBuffer) {
+	KeyValue kv("a", std::string(100, 'x'));
+	const auto* data = kv.get_value().data();
+
+	kv.set_value(std::numeric_limits<std::uint64_t>::max());
+	EXPECT_EQ(kv.get_value(), "18446744073709551615");
+	kv.set_value(-0.5);
+	EXPECT_EQ(kv.get_value(), "-0.5");
+	kv.set_value("str");
+	EXPECT_EQ(kv.get_value(), "str");
+	EXPECT_EQ(kv.get_value().data(), data);
+
+	// Moved string is taken over as it is
+	std::string value(200, 'y');
+	const auto* value_data = value.data();
+	kv.set_value(std::move(value));
+	EXPECT_EQ(kv.get_value().data(), value_data);
+	EXPECT_EQ(KeyValue("a", std::string(200, 'z')).get_value(), std::string(200, 'z'));
+}
+
+TEST_F(TestKeyValue,
+GetIntegers) {
+	EXPECT_EQ(KeyValue("a", "12").get_value_as<int>(), 12);
+	EXPECT_EQ(KeyValue("a", " 12 ").get_value_as<std::uint64_t>(), 12u);
+	EXPECT_EQ(KeyValue("a", "-5").get_value_as<long>(), -5);
+	EXPECT_EQ(KeyValue("a", "18446744073709551615").get_value_as<std::uint64_t>(), std::numeric_limits<std::uint64_t>::max());
+}
+
+TEST_F(TestKeyValue,
+GetFloatingPoint) {
+	EXPECT_DOUBLE_EQ(KeyValue("a", "0.5").get_value_as<double>(), 0.5);
+	EXPECT_FLOAT_EQ(KeyValue("a", "-1e3").get_value_as<float>(), -1000.0f);
+}
+
+TEST_F(TestKeyValue,
+GetBool) {
+	EXPECT_TRUE(KeyValue("a", "true").get_value_as<bool>());
+	EXPECT_TRUE(KeyValue("a", "TRUE").get_value_as<bool>());
+	EXPECT_FALSE(KeyValue("a", "false").get_value_as<bool>());
+	EXPECT_FALSE(KeyValue("a", "xyz").get_value_as<bool>());
+	EXPECT_EQ(KeyValue("a", "xyz").try_get_value_as<bool>(), std::nullopt);
+}
+
+TEST_F(TestKeyValue,
+GetInvalid) {
+	EXPECT_EQ(KeyValue("a", "").try_get_value_as<int>(), std::nullopt);
+	EXPECT_EQ(KeyValue("a", "12abc").try_get_value_as<int>(), std::nullopt);
+	EXPECT_EQ(KeyValue("a", "-1").try_get_value_as<std::uint64_t>(), std::nullopt);
+	EXPECT_EQ(KeyValue("a", "18446744073709551616").try_get_value_as<std::uint64_t>(), std::nullopt);
+	EXPECT_EQ(KeyValue("a", "300").try_get_value_as<std::uint8_t>(), std::nullopt);
+	EXPECT_THROW(KeyValue("a", "abc").get_value_as<int>(), std::invalid_argument);
+}
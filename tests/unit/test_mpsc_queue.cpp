@@ -0,0 +1,93 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+
+#include <poll.h>
+
+#include <ulocal/event_fd.hpp>
+#include <ulocal/mpsc_queue.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestMpscQueue : public ::testing::Test {};
+
+TEST_F(TestMpscQueue,
+FifoOrder) {
+	MpscQueue<int> queue;
+	EXPECT_EQ(queue.pop(), std::nullopt);
+
+	queue.push(1);
+	queue.push(2);
+	queue.push(3);
+	EXPECT_EQ(queue.pop(), 1);
+	EXPECT_EQ(queue.pop(), 2);
+
+	queue.push(4);
+	EXPECT_EQ(queue.pop(), 3);
+	EXPECT_EQ(queue.pop(), 4);
+	EXPECT_EQ(queue.pop(), std::nullopt);
+}
+
+TEST_F(TestMpscQueue,
+MoveOnlyValuesAreReleased) {
+	auto value = std::make_shared<int>(42);
+	{
+		MpscQueue<std::shared_ptr<int>> queue;
+		queue.push(value);
+		queue.push(value);
+		EXPECT_EQ(value.use_count(), 3);
+
+		auto popped = queue.pop();
+		ASSERT_TRUE(popped);
+		EXPECT_EQ(**popped, 42);
+	}
+	EXPECT_EQ(value.use_count(), 1);
+}
+
+TEST_F(TestMpscQueue,
+MultipleProducers) {
+	constexpr int ProducerCount = 4;
+	constexpr int ItemCount = 10000;
+
+	MpscQueue<std::pair<int, int>> queue;
+	std::vector<std::thread> producers;
+	for (int producer = 0; producer < ProducerCount; ++producer)
+		producers.emplace_back([&queue, producer]() {
+			for (int i = 0; i < ItemCount; ++i)
+				queue.push({producer, i});
+		});
+
+	std::vector<int> next(ProducerCount, 0);
+	int received = 0;
+	while (received < ProducerCount * ItemCount)
+	{
+		if (auto item = queue.pop())
+		{
+			// Items of a single producer keep their order
+			EXPECT_EQ(item->second, next[item->first]);
+			next[item->first] = item->second + 1;
+			++received;
+		}
+	}
+
+	for (auto& producer : producers)
+		producer.join();
+	EXPECT_EQ(queue.pop(), std::nullopt);
+}
+
+TEST_F(TestMpscQueue,
+EventFdWakeUp) {
+	EventFd event;
+	pollfd fd = {event.get_fd(), POLLIN, 0};
+	EXPECT_EQ(::poll(&fd, 1, 0), 0);
+
+	event.notify();
+	event.notify();
+	EXPECT_EQ(::poll(&fd, 1, 0), 1);
+
+	event.consume();
+	EXPECT_EQ(::poll(&fd, 1, 0), 0);
+}
@@ -0,0 +1,120 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <sys/socket.h>
+
+#include <ulocal/poller.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestPoller : public ::testing::Test
+{
+public:
+	TestPoller() : fds()
+	{
+		::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+	}
+
+	~TestPoller()
+	{
+		::close(fds[0]);
+		::close(fds[1]);
+	}
+
+	std::vector<std::unique_ptr<Poller>> create_pollers()
+	{
+		std::vector<std::unique_ptr<Poller>> result;
+		for (auto backend : {PollerBackend::Epoll, PollerBackend::Poll})
+			result.push_back(create_poller(backend));
+		return result;
+	}
+
+	int fds[2];
+};
+
+TEST_F(TestPoller,
+CreatePoller) {
+	EXPECT_EQ(create_poller()->get_backend(), PollerBackend::Epoll);
+	EXPECT_EQ(create_poller(PollerBackend::Poll)->get_backend(), PollerBackend::Poll);
+	EXPECT_EQ(get_poller_backend_name(PollerBackend::Epoll), "epoll");
+}
+
+TEST_F(TestPoller,
+ReadReadiness) {
+	for (auto& poller : create_pollers())
+	{
+		SCOPED_TRACE(get_poller_backend_name(poller->get_backend()));
+
+		std::vector<PollEvent> events;
+		poller->add(fds[0], 42, POLLIN);
+		poller->wait(events, 0);
+		EXPECT_THAT(events, IsEmpty());
+
+		ASSERT_EQ(::write(fds[1], "x", 1), 1);
+		poller->wait(events, 1000);
+		ASSERT_EQ(events.size(), 1u);
+		EXPECT_EQ(events[0].token, 42u);
+		EXPECT_TRUE(events[0].events & POLLIN);
+
+		// Notifications are level-triggered so unread data is reported again
+		poller->wait(events, 1000);
+		ASSERT_EQ(events.size(), 1u);
+
+		char c;
+		ASSERT_EQ(::read(fds[0], &c, 1), 1);
+		poller->wait(events, 0);
+		EXPECT_THAT(events, IsEmpty());
+
+		poller->remove(fds[0]);
+	}
+}
+
+TEST_F(TestPoller,
+ModifyAndRemove) {
+	for (auto& poller : create_pollers())
+	{
+		SCOPED_TRACE(get_poller_backend_name(poller->get_backend()));
+
+		std::vector<PollEvent> events;
+		poller->add(fds[0], 1, POLLIN);
+		poller->wait(events, 0);
+		EXPECT_THAT(events, IsEmpty());
+
+		poller->modify(fds[0], 2, POLLOUT);
+		poller->wait(events, 1000);
+		ASSERT_EQ(events.size(), 1u);
+		EXPECT_EQ(events[0].token, 2u);
+		EXPECT_TRUE(events[0].events & POLLOUT);
+
+		poller->remove(fds[0]);
+		ASSERT_EQ(::write(fds[1], "x", 1), 1);
+		poller->wait(events, 0);
+		EXPECT_THAT(events, IsEmpty());
+
+		char c;
+		ASSERT_EQ(::read(fds[0], &c, 1), 1);
+	}
+}
+
+TEST_F(TestPoller,
+HangUp) {
+	for (auto& poller : create_pollers())
+	{
+		SCOPED_TRACE(get_poller_backend_name(poller->get_backend()));
+
+		int pair[2];
+		ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, pair), 0);
+
+		std::vector<PollEvent> events;
+		poller->add(pair[0], 7, POLLIN);
+		::close(pair[1]);
+		poller->wait(events, 1000);
+		ASSERT_EQ(events.size(), 1u);
+		EXPECT_EQ(events[0].token, 7u);
+		EXPECT_TRUE(events[0].events & POLLHUP);
+
+		poller->remove(pair[0]);
+		::close(pair[0]);
+	}
+}
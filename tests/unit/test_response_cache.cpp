@@ -0,0 +1,127 @@
+#include <thread>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <ulocal/response_cache.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestResponseCache : public ::testing::Test
+{
+public:
+	using Clock = ResponseCache::Clock;
+
+	std::shared_ptr<const CachedResponse> response(const std::string& content)
+	{
+		return std::make_shared<CachedResponse>(CachedResponse{HttpResponse{200, content}, {}});
+	}
+
+	Clock::time_point later()
+	{
+		return Clock::now() + std::chrono::hours(1);
+	}
+};
+
+TEST_F(TestResponseCache,
+InsertAndFind) {
+	ResponseCache cache{1 << 20, 4};
+	EXPECT_FALSE(cache.find("a"));
+
+	ASSERT_TRUE(cache.insert("a", "/a", response("first"), later()));
+	ASSERT_TRUE(cache.find("a"));
+	EXPECT_EQ(cache.find("a")->response.get_content(), "first");
+	EXPECT_EQ(cache.size(), 1u);
+
+	auto memory_usage = cache.get_memory_usage();
+	EXPECT_GT(memory_usage, 0u);
+
+	ASSERT_TRUE(cache.insert("a", "/a", response("second"), later()));
+	EXPECT_EQ(cache.find("a")->response.get_content(), "second");
+	EXPECT_EQ(cache.size(), 1u);
+	EXPECT_EQ(cache.get_memory_usage(), memory_usage + 1);
+}
+
+TEST_F(TestResponseCache,
+Expiration) {
+	ResponseCache cache{1 << 20};
+	auto now = Clock::now();
+	cache.insert("a", "/a", response("abc"), now + std::chrono::seconds(1));
+
+	EXPECT_TRUE(cache.find("a", now));
+	EXPECT_FALSE(cache.find("a", now + std::chrono::seconds(1)));
+	EXPECT_EQ(cache.size(), 0u);
+	EXPECT_EQ(cache.get_memory_usage(), 0u);
+}
+
+TEST_F(TestResponseCache,
+MemoryBudget) {
+	auto entry_size = response(std::string(1000, 'x'))->get_size() + 2;
+	ResponseCache cache{entry_size * 3, 1};
+
+	EXPECT_FALSE(cache.insert("big", "/", response(std::string(entry_size * 3, 'x')), later()));
+	EXPECT_EQ(cache.size(), 0u);
+
+	cache.insert("a", "/", response(std::string(1000, 'x')), later());
+	cache.insert("b", "/", response(std::string(1000, 'x')), later());
+	cache.insert("c", "/", response(std::string(1000, 'x')), later());
+	EXPECT_EQ(cache.size(), 3u);
+
+	// Entries which were looked up get a second chance so the first one which wasn't is evicted
+	EXPECT_TRUE(cache.find("a"));
+	EXPECT_TRUE(cache.find("c"));
+	cache.insert("d", "/", response(std::string(1000, 'x')), later());
+	EXPECT_EQ(cache.size(), 3u);
+	EXPECT_TRUE(cache.find("a"));
+	EXPECT_FALSE(cache.find("b"));
+	EXPECT_TRUE(cache.find("c"));
+	EXPECT_TRUE(cache.find("d"));
+	EXPECT_LE(cache.get_memory_usage(), entry_size * 3);
+}
+
+TEST_F(TestResponseCache,
+InvalidatePrefix) {
+	ResponseCache cache{1 << 20, 4};
+	cache.insert("1", "/items", response("a"), later());
+	cache.insert("2", "/items/1", response("b"), later());
+	cache.insert("3", "/item", response("c"), later());
+	cache.insert("4", "/users", response("d"), later());
+
+	EXPECT_EQ(cache.invalidate("/items"), 2u);
+	EXPECT_FALSE(cache.find("1"));
+	EXPECT_FALSE(cache.find("2"));
+	EXPECT_TRUE(cache.find("3"));
+	EXPECT_TRUE(cache.find("4"));
+
+	cache.clear();
+	EXPECT_EQ(cache.size(), 0u);
+	EXPECT_EQ(cache.get_memory_usage(), 0u);
+}
+
+TEST_F(TestResponseCache,
+ConcurrentAccess) {
+	ResponseCache cache{1 << 16, 4};
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&, t]() {
+			for (int i = 0; i < 2000; ++i)
+			{
+				auto key = std::to_string((i * 7 + t) % 100);
+				if (i % 3 == 0)
+					cache.insert(key, "/" + key, response(std::string(100, 'x')), later());
+				else if (i % 100 == 0)
+					cache.invalidate("/1");
+				else if (auto found = cache.find(key))
+				{
+					EXPECT_EQ(found->response.get_content().length(), 100u);
+				}
+			}
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	EXPECT_LE(cache.get_memory_usage(), std::size_t{1} << 16);
+}
@@ -0,0 +1,95 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <ulocal/server_metrics.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestServerMetrics : public ::testing::Test {};
+
+TEST_F(TestServerMetrics,
+HistogramBuckets) {
+	for (std::uint64_t value : {0ull, 1ull, 7ull, 8ull, 9ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull, ~0ull})
+	{
+		auto index = LatencyHistogram::bucket_index(value);
+		ASSERT_LT(index, LatencyHistogram::BucketCount);
+		EXPECT_GE(LatencyHistogram::bucket_upper_bound(index), value);
+		if (index > 0)
+		{
+			EXPECT_LT(LatencyHistogram::bucket_upper_bound(index - 1), value);
+		}
+	}
+}
+
+TEST_F(TestServerMetrics,
+HistogramSnapshot) {
+	LatencyHistogram histogram;
+	for (std::uint64_t i = 1; i <= 100; ++i)
+		histogram.record(i * 1000);
+
+	auto snapshot = histogram.snapshot();
+	EXPECT_EQ(snapshot.count, 100u);
+	EXPECT_EQ(snapshot.sum_ns, 5050u * 1000);
+	EXPECT_NEAR(static_cast<double>(snapshot.percentile(0.5)), 50000.0, 50000.0 * 0.125);
+	EXPECT_NEAR(static_cast<double>(snapshot.percentile(0.99)), 99000.0, 99000.0 * 0.125);
+	EXPECT_EQ(snapshot.count_up_to(~0ull), 100u);
+	EXPECT_EQ(snapshot.count_up_to(0), 0u);
+}
+
+TEST_F(TestServerMetrics,
+RouteResponses) {
+	RouteMetrics metrics;
+	metrics.record_response(200);
+	metrics.record_response(200);
+	metrics.record_response(404);
+	metrics.record_response(299);
+
+	EXPECT_THAT(metrics.get_responses(), ElementsAre(Pair(200, 2u), Pair(404, 1u), Pair(0, 1u)));
+}
+
+TEST_F(TestServerMetrics,
+Snapshot) {
+	ServerMetrics metrics;
+	metrics.add(ServerMetrics::AcceptedConnections, 3);
+	metrics.add(ServerMetrics::ClosedConnections, 2);
+	metrics.add(ServerMetrics::BytesIn, 100);
+	metrics.register_route("/b")->record_response(200);
+	metrics.register_route("/a")->record_response(500);
+	metrics.find_route("/missing")->record_response(404);
+
+	auto snapshot = metrics.snapshot();
+	EXPECT_EQ(snapshot.accepted_connections, 3u);
+	EXPECT_EQ(snapshot.closed_connections, 2u);
+	EXPECT_EQ(snapshot.active_connections, 1u);
+	EXPECT_EQ(snapshot.bytes_in, 100u);
+	ASSERT_EQ(snapshot.routes.size(), 3u);
+	EXPECT_EQ(snapshot.routes[0].route, "/a");
+	EXPECT_EQ(snapshot.routes[1].route, "/b");
+	EXPECT_EQ(snapshot.routes[2].route, "<unmatched>");
+	EXPECT_EQ(metrics.find_route("/A"), metrics.register_route("/a"));
+}
+
+TEST_F(TestServerMetrics,
+Prometheus) {
+	ServerMetrics metrics;
+	metrics.add(ServerMetrics::AcceptedConnections);
+	auto* route = metrics.register_route("/status");
+	route->record_response(200);
+	route->record_handler_time(2'000'000);
+	metrics.find_route("/missing")->record_response(404);
+	metrics.record_handler_time(2'000'000);
+
+	auto text = metrics.snapshot().to_prometheus();
+	EXPECT_THAT(text, HasSubstr("ulocal_connections_accepted_total 1\n"));
+	EXPECT_THAT(text, HasSubstr("ulocal_requests_total{route=\"/status\",code=\"200\"} 1\n"));
+	EXPECT_THAT(text, HasSubstr("ulocal_route_handler_duration_seconds_bucket{route=\"/status\",le=\"0.001\"} 0\n"));
+	EXPECT_THAT(text, HasSubstr("ulocal_route_handler_duration_seconds_bucket{route=\"/status\",le=\"0.0025\"} 1\n"));
+	EXPECT_THAT(text, HasSubstr("ulocal_route_handler_duration_seconds_count{route=\"/status\"} 1\n"));
+	EXPECT_THAT(text, HasSubstr("ulocal_requests_total{route=\"<unmatched>\",code=\"404\"} 1\n"));
+	EXPECT_THAT(text, HasSubstr("ulocal_route_handler_duration_seconds_count{route=\"<unmatched>\"} 0\n"));
+	// Series without route label only belongs to the handler time of all requests
+	EXPECT_THAT(text, Not(HasSubstr("ulocal_route_handler_duration_seconds_count ")));
+	EXPECT_THAT(text, HasSubstr("ulocal_handler_duration_seconds_count 1\n"));
+	EXPECT_THAT(text, HasSubstr("# TYPE ulocal_parse_duration_seconds histogram\n"));
+}
@@ -0,0 +1,104 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <ulocal/http_response.hpp>
+#include <ulocal/shared_body.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestSharedBody : public ::testing::Test {};
+
+TEST_F(TestSharedBody,
+ShareAndUnshare) {
+	std::string content(100000, 'x');
+	HttpResponse response{200, content};
+	ASSERT_TRUE(share_body(response));
+	EXPECT_TRUE(response.get_content().empty());
+	ASSERT_EQ(response.get_fds().size(), 1u);
+	ASSERT_TRUE(response.get_header(SharedBodyHeader));
+	EXPECT_EQ(response.get_header(SharedBodyHeader)->get_value(), "0 0 100000");
+	EXPECT_EQ(::write(response.get_fds()[0].get(), "y", 1), -1);
+
+	unshare_body(response);
+	EXPECT_EQ(response.get_content(), content);
+	EXPECT_TRUE(response.get_fds().empty());
+	EXPECT_FALSE(response.has_header(SharedBodyHeader));
+	ASSERT_TRUE(response.get_header(HttpHeaderId::ContentLength));
+	EXPECT_EQ(response.get_header(HttpHeaderId::ContentLength)->get_value(), "100000");
+}
+
+TEST_F(TestSharedBody,
+MessagesWhichCantBeShared) {
+	HttpResponse empty{200};
+	EXPECT_FALSE(share_body(empty));
+
+	HttpResponse with_length{200, "abc"};
+	with_length.calculate_content_length();
+	EXPECT_FALSE(share_body(with_length));
+	EXPECT_EQ(with_length.get_content(), "abc");
+	EXPECT_TRUE(with_length.get_fds().empty());
+}
+
+TEST_F(TestSharedBody,
+InvalidReference) {
+	HttpResponse response{200, "abc"};
+	ASSERT_TRUE(share_body(response));
+
+	auto too_long = response;
+	too_long.remove_header(SharedBodyHeader);
+	too_long.add_header(SharedBodyHeader, "0 1 3");
+	EXPECT_THROW(unshare_body(too_long), ParseError);
+
+	auto missing_fd = response;
+	missing_fd.remove_header(SharedBodyHeader);
+	missing_fd.add_header(SharedBodyHeader, "1 0 3");
+	EXPECT_THROW(unshare_body(missing_fd), ParseError);
+
+	auto malformed = response;
+	malformed.remove_header(SharedBodyHeader);
+	malformed.add_header(SharedBodyHeader, "0 0");
+	EXPECT_THROW(unshare_body(malformed), ParseError);
+}
+
+TEST_F(TestSharedBody,
+RejectedSharedBodies) {
+	HttpResponse response{200, "abc"};
+	ASSERT_TRUE(share_body(response));
+
+	auto not_accepted = response;
+	EXPECT_THROW(unshare_body(not_accepted, 0), ParseError);
+
+	auto too_large = response;
+	EXPECT_THROW(unshare_body(too_large, 2), ParseError);
+
+	auto within_limit = response;
+	unshare_body(within_limit, 3);
+	EXPECT_EQ(within_limit.get_content(), "abc");
+}
+
+TEST_F(TestSharedBody,
+UnsealedOrIrregularFiles) {
+	auto with_fd = [](FileDescriptor&& fd) {
+		HttpResponse response{200};
+		response.add_header(SharedBodyHeader, "0 0 3");
+		response.add_fd(std::move(fd));
+		return response;
+	};
+
+	FileDescriptor unsealed{::memfd_create("test", MFD_CLOEXEC | MFD_ALLOW_SEALING)};
+	ASSERT_EQ(::write(unsealed.get(), "abc", 3), 3);
+	auto unsealed_response = with_fd(FileDescriptor{unsealed});
+	EXPECT_THROW(unshare_body(unsealed_response), ParseError);
+
+	// Sealed against writes but it can still be truncated under the reader's hands
+	ASSERT_EQ(::fcntl(unsealed.get(), F_ADD_SEALS, F_SEAL_WRITE), 0);
+	auto partially_sealed = with_fd(FileDescriptor{unsealed});
+	EXPECT_THROW(unshare_body(partially_sealed), ParseError);
+
+	int pipe_fds[2];
+	ASSERT_EQ(::pipe2(pipe_fds, O_CLOEXEC), 0);
+	FileDescriptor write_end{pipe_fds[1]};
+	auto pipe_response = with_fd(FileDescriptor{pipe_fds[0]});
+	EXPECT_THROW(unshare_body(pipe_response), ParseError);
+}
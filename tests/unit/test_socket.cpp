@@ -0,0 +1,207 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+
+#include <ulocal/socket.hpp>
+#include <ulocal/socket_activation.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestSocket : public ::testing::Test
+{
+public:
+	TestSocket() : dir_template("/tmp/ulocal-test-XXXXXX"), socket_path()
+	{
+		::mkdtemp(dir_template);
+		socket_path = std::string{dir_template} + "/test.sock";
+	}
+
+	~TestSocket()
+	{
+		::unlink(socket_path.c_str());
+		::rmdir(dir_template);
+	}
+
+	static bool is_non_blocking(int fd) { return ::fcntl(fd, F_GETFL) & O_NONBLOCK; }
+	static bool is_close_on_exec(int fd) { return ::fcntl(fd, F_GETFD) & FD_CLOEXEC; }
+
+	char dir_template[32];
+	std::string socket_path;
+};
+
+TEST_F(TestSocket,
+SocketsAreNonBlockingAndCloseOnExec) {
+	Socket<> server;
+	server.listen(socket_path);
+	EXPECT_TRUE(server.is_listening());
+	EXPECT_FALSE(server.accept_connection());
+
+	Socket<> client;
+	client.connect(socket_path);
+	auto accepted = server.accept_connection();
+	ASSERT_TRUE(accepted);
+
+	for (int fd : {server.get_fd(), client.get_fd(), accepted->get_fd()})
+	{
+		EXPECT_TRUE(is_non_blocking(fd));
+		EXPECT_TRUE(is_close_on_exec(fd));
+	}
+}
+
+TEST_F(TestSocket,
+AdoptedDescriptorKeepsItsFlags) {
+	int fds[2];
+	ASSERT_EQ(::pipe2(fds, O_CLOEXEC), 0);
+	ASSERT_EQ(::fcntl(fds[1], F_SETFL, O_APPEND), 0);
+
+	Socket<NonNetwork> read_end(fds[0]);
+	Socket<NonNetwork> write_end(fds[1]);
+	EXPECT_TRUE(is_non_blocking(fds[0]));
+	EXPECT_TRUE(is_non_blocking(fds[1]));
+	EXPECT_TRUE(::fcntl(fds[1], F_GETFL) & O_APPEND);
+
+	write_end.write("hello");
+	EXPECT_TRUE(read_end.read());
+	EXPECT_EQ(read_end.get_stream().as_string_view(), "hello");
+}
+
+TEST_F(TestSocket,
+ListeningSocketIsHandedOverToAnotherSocket) {
+	int fds[2];
+	ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds), 0);
+	Socket<> sender(fds[0]);
+	Socket<> receiver(fds[1]);
+
+	std::optional<Socket<>> server{std::in_place};
+	server->listen(socket_path);
+	send_listening_socket(sender, server.value());
+
+	// Closing the original must not affect the listen queue of the received socket
+	Socket<> client;
+	client.connect(socket_path);
+	server.reset();
+
+	auto received = receive_listening_socket(receiver);
+	EXPECT_TRUE(received.is_listening());
+	EXPECT_TRUE(is_non_blocking(received.get_fd()));
+	EXPECT_TRUE(is_close_on_exec(received.get_fd()));
+	EXPECT_TRUE(received.accept_connection());
+
+	Socket<> another_client;
+	another_client.connect(socket_path);
+	EXPECT_TRUE(received.accept_connection());
+}
+
+TEST_F(TestSocket,
+NonListeningSocketIsNotAdopted) {
+	Socket<> socket;
+	EXPECT_THROW(Socket<>::from_listening_fd(socket.get_fd()), SocketError);
+	EXPECT_EQ(::fcntl(socket.get_fd(), F_GETFD), FD_CLOEXEC);
+}
+
+TEST_F(TestSocket,
+ActivatedSocketsArePassedThroughEnvironment) {
+	Socket<> server;
+	server.listen(socket_path);
+
+	// Descriptor 3 may already be used by the test runner so it's restored at the end
+	int saved_fd = ::fcntl(ListenFdsStart, F_DUPFD_CLOEXEC, 10);
+	ASSERT_EQ(::dup2(server.get_fd(), ListenFdsStart), ListenFdsStart);
+
+	auto pid = std::to_string(::getpid());
+	::setenv("LISTEN_PID", "1", 1);
+	::setenv("LISTEN_FDS", "1", 1);
+	EXPECT_TRUE(get_activated_sockets(false).empty());
+
+	::setenv("LISTEN_PID", pid.c_str(), 1);
+	auto sockets = get_activated_sockets();
+	EXPECT_EQ(::getenv("LISTEN_PID"), nullptr);
+	EXPECT_EQ(::getenv("LISTEN_FDS"), nullptr);
+	ASSERT_EQ(sockets.size(), 1u);
+	EXPECT_EQ(sockets[0].get_fd(), ListenFdsStart);
+
+	Socket<> client;
+	client.connect(socket_path);
+	EXPECT_TRUE(sockets[0].accept_connection());
+
+	sockets.clear();
+	if (saved_fd >= 0)
+	{
+		::dup2(saved_fd, ListenFdsStart);
+		::close(saved_fd);
+	}
+}
+
+TEST_F(TestSocket,
+PeerCredentialsOfConnectedSocket) {
+	Socket<> server;
+	server.listen(socket_path);
+
+	Socket<> client;
+	client.connect(socket_path);
+	auto accepted = server.accept_connection();
+	ASSERT_TRUE(accepted);
+
+	auto credentials = accepted->get_peer_credentials();
+	ASSERT_TRUE(credentials);
+	EXPECT_EQ(credentials->pid, ::getpid());
+	EXPECT_EQ(credentials->uid, ::getuid());
+	EXPECT_EQ(credentials->gid, ::getgid());
+}
+
+TEST_F(TestSocket,
+FileDescriptorsArePassedWithData) {
+	int fds[2];
+	ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds), 0);
+	Socket<> sender(fds[0]);
+	Socket<> receiver(fds[1]);
+
+	int pipe_fds[2];
+	ASSERT_EQ(::pipe2(pipe_fds, O_CLOEXEC), 0);
+	std::vector<FileDescriptor> to_send;
+	to_send.emplace_back(pipe_fds[0]);
+	to_send.emplace_back(pipe_fds[1]);
+
+	EXPECT_EQ(sender.write("first", to_send), 5u);
+	EXPECT_EQ(sender.write("second"), 6u);
+	to_send.clear();
+
+	EXPECT_TRUE(receiver.read());
+	EXPECT_EQ(receiver.get_stream().as_string_view(), "firstsecond");
+	ASSERT_EQ(receiver.get_received_fd_count(), 2u);
+
+	auto received = receiver.take_received_fds(2);
+	EXPECT_EQ(receiver.get_received_fd_count(), 0u);
+	EXPECT_TRUE(::fcntl(received[0].get(), F_GETFD) & FD_CLOEXEC);
+	ASSERT_EQ(::write(received[1].get(), "x", 1), 1);
+	char c;
+	EXPECT_EQ(::read(received[0].get(), &c, 1), 1);
+	EXPECT_EQ(c, 'x');
+}
+
+TEST_F(TestSocket,
+AbstractNamespaceSocket) {
+	auto name = "@ulocal-test-" + std::to_string(::getpid());
+	Socket<> server;
+	server.listen(name);
+
+	Socket<> client;
+	client.connect(name);
+	EXPECT_TRUE(server.accept_connection());
+
+	Socket<> same_name_with_null;
+	same_name_with_null.connect(std::string{'\0'} + name.substr(1));
+	EXPECT_TRUE(server.accept_connection());
+
+	Socket<> another_server;
+	EXPECT_THROW(another_server.listen(name), SocketError);
+}
+
+TEST_F(TestSocket,
+TooLongPathIsNotTruncated) {
+	Socket<> socket;
+	EXPECT_THROW(socket.listen(std::string(sizeof(sockaddr_un::sun_path), 'x')), SocketError);
+	EXPECT_THROW(socket.connect(""), SocketError);
+}
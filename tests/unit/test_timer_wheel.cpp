@@ -0,0 +1,136 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <ulocal/timer_wheel.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+using namespace std::chrono_literals;
+
+class TestTimerWheel : public ::testing::Test
+{
+public:
+	TestTimerWheel() : start(TimerWheel::Clock::now()), wheel(10ms, start) {}
+
+	std::vector<std::uint64_t> advance(std::chrono::milliseconds elapsed)
+	{
+		std::vector<std::uint64_t> result;
+		wheel.advance(start + elapsed, [&](std::uint64_t payload) { result.push_back(payload); });
+		return result;
+	}
+
+	TimerWheel::Clock::time_point start;
+	TimerWheel wheel;
+};
+
+TEST_F(TestTimerWheel,
+EmptyWheel) {
+	EXPECT_TRUE(wheel.empty());
+	EXPECT_EQ(wheel.time_until_next(start), std::nullopt);
+	EXPECT_THAT(advance(1h), IsEmpty());
+}
+
+TEST_F(TestTimerWheel,
+ExpiresInOrder) {
+	wheel.schedule(start + 30ms, 3);
+	wheel.schedule(start + 10ms, 1);
+	wheel.schedule(start + 20ms, 2);
+	EXPECT_EQ(wheel.size(), 3u);
+
+	EXPECT_THAT(advance(5ms), IsEmpty());
+	EXPECT_THAT(advance(10ms), ElementsAre(1));
+	EXPECT_THAT(advance(100ms), ElementsAre(2, 3));
+	EXPECT_TRUE(wheel.empty());
+}
+
+TEST_F(TestTimerWheel,
+NeverExpiresEarly) {
+	wheel.schedule(start + 15ms, 1);
+
+	EXPECT_THAT(advance(14ms), IsEmpty());
+	EXPECT_THAT(advance(19ms), IsEmpty());
+	EXPECT_THAT(advance(20ms), ElementsAre(1));
+}
+
+TEST_F(TestTimerWheel,
+Cancel) {
+	auto first = wheel.schedule(start + 10ms, 1);
+	wheel.schedule(start + 10ms, 2);
+	wheel.cancel(first);
+	wheel.cancel(first);
+	wheel.cancel(TimerWheel::InvalidTimer);
+
+	EXPECT_EQ(wheel.size(), 1u);
+	EXPECT_THAT(advance(10ms), ElementsAre(2));
+}
+
+TEST_F(TestTimerWheel,
+CascadesFromUpperLevels) {
+	wheel.schedule(start + 1s, 1);
+	wheel.schedule(start + 1min, 2);
+	wheel.schedule(start + 1h, 3);
+	wheel.schedule(start + 72h, 4);
+
+	EXPECT_THAT(advance(999ms), IsEmpty());
+	EXPECT_THAT(advance(1s), ElementsAre(1));
+	EXPECT_THAT(advance(59s), IsEmpty());
+	EXPECT_THAT(advance(60s), ElementsAre(2));
+	EXPECT_THAT(advance(3599s), IsEmpty());
+	EXPECT_THAT(advance(3600s), ElementsAre(3));
+	EXPECT_THAT(advance(71h), IsEmpty());
+	EXPECT_THAT(advance(72h), ElementsAre(4));
+}
+
+TEST_F(TestTimerWheel,
+AdvanceInSmallSteps) {
+	for (std::uint64_t i = 1; i <= 200; ++i)
+		wheel.schedule(start + std::chrono::milliseconds(i * 37), i);
+
+	std::vector<std::uint64_t> expired;
+	for (auto now = 0ms; now <= 10s; now += 3ms)
+	{
+		for (auto payload : advance(now))
+		{
+			EXPECT_GE(now.count(), static_cast<std::int64_t>(payload * 37));
+			EXPECT_LT(now.count(), static_cast<std::int64_t>(payload * 37 + 13));
+			expired.push_back(payload);
+		}
+	}
+
+	ASSERT_EQ(expired.size(), 200u);
+	EXPECT_TRUE(std::is_sorted(expired.begin(), expired.end()));
+}
+
+TEST_F(TestTimerWheel,
+TimeUntilNext) {
+	wheel.schedule(start + 25ms, 1);
+	EXPECT_EQ(wheel.time_until_next(start), 30ms);
+	EXPECT_EQ(wheel.time_until_next(start + 40ms), 0ms);
+
+	// Upper level timers wake the wheel up no later than they need to be cascaded
+	TimerWheel far_wheel(10ms, start);
+	far_wheel.schedule(start + 1h, 1);
+	auto wake_up = far_wheel.time_until_next(start);
+	ASSERT_NE(wake_up, std::nullopt);
+	EXPECT_LE(*wake_up, 1h);
+}
+
+TEST_F(TestTimerWheel,
+ScheduleFromCallback) {
+	wheel.schedule(start + 10ms, 1);
+	auto second = wheel.schedule(start + 10ms, 2);
+
+	std::vector<std::uint64_t> expired;
+	wheel.advance(start + 10ms, [&](std::uint64_t payload) {
+		expired.push_back(payload);
+		// Cancels the other timer expiring at the same time and reschedules into the past
+		wheel.cancel(second);
+		wheel.cancel(payload == 1 ? TimerWheel::InvalidTimer : 0);
+		if (payload < 10)
+			wheel.schedule(start, payload + 10);
+	});
+
+	ASSERT_EQ(expired.size(), 1u);
+	EXPECT_EQ(wheel.size(), 1u);
+	EXPECT_THAT(advance(20ms), ElementsAre(expired[0] + 10));
+}
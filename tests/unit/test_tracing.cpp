@@ -0,0 +1,75 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include <ulocal/tracing.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestTracing : public ::testing::Test {};
+
+TEST_F(TestTracing,
+EventNames) {
+	EXPECT_EQ(get_trace_event_name(TraceEvent::Accept), "accept");
+	EXPECT_EQ(get_trace_event_name(TraceEvent::WriteComplete), "write_complete");
+	EXPECT_EQ(get_trace_event_name(TraceEvent::Close), "close");
+}
+
+TEST_F(TestTracing,
+RingBufferKeepsRecordsInOrder) {
+	TraceRingBuffer buffer(8);
+	buffer.record({100, 1, 0, TraceEvent::Accept});
+	buffer.record({200, 1, 1, TraceEvent::RequestParsed});
+
+	auto records = buffer.get_records();
+	ASSERT_EQ(records.size(), 2u);
+	EXPECT_EQ(records[0].timestamp_ns, 100u);
+	EXPECT_EQ(records[0].event, TraceEvent::Accept);
+	EXPECT_EQ(records[1].request_id, 1u);
+	EXPECT_EQ(records[1].event, TraceEvent::RequestParsed);
+}
+
+TEST_F(TestTracing,
+RingBufferOverwritesOldest) {
+	TraceRingBuffer buffer(5);
+	for (std::uint64_t i = 0; i < 20; ++i)
+		buffer.record({i, 1, i, TraceEvent::ReadComplete});
+
+	auto records = buffer.get_records();
+	ASSERT_EQ(records.size(), 8u);
+	EXPECT_EQ(records.front().request_id, 12u);
+	EXPECT_EQ(records.back().request_id, 19u);
+}
+
+TEST_F(TestTracing,
+RingBufferConcurrentWriters) {
+	TraceRingBuffer buffer(1 << 12);
+	std::vector<std::thread> threads;
+	for (std::uint64_t t = 0; t < 4; ++t)
+		threads.emplace_back([&buffer, t]() {
+			for (std::uint64_t i = 0; i < 1000; ++i)
+				buffer.record(TraceEvent::HandlerStart, t, i);
+		});
+	for (auto& thread : threads)
+		thread.join();
+
+	EXPECT_EQ(buffer.get_records().size(), 4000u);
+}
+
+TEST_F(TestTracing,
+ChromeTrace) {
+	TraceRingBuffer buffer(8);
+	buffer.record({1234567, 3, 7, TraceEvent::HandlerStart});
+	buffer.record({1235000, 3, 7, TraceEvent::HandlerEnd});
+	buffer.record({1236000, 3, 7, TraceEvent::Close});
+
+	EXPECT_EQ(buffer.to_chrome_trace(),
+		"{\"traceEvents\":["
+		"{\"name\":\"handler\",\"ph\":\"B\",\"ts\":1234.567,\"pid\":1,\"tid\":3,\"args\":{\"request_id\":7}},"
+		"{\"name\":\"handler\",\"ph\":\"E\",\"ts\":1235.000,\"pid\":1,\"tid\":3,\"args\":{\"request_id\":7}},"
+		"{\"name\":\"close\",\"ph\":\"i\",\"ts\":1236.000,\"pid\":1,\"tid\":3,\"s\":\"t\",\"args\":{\"request_id\":7}}"
+		"],\"displayTimeUnit\":\"ns\"}"
+	);
+}
@@ -0,0 +1,131 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <ulocal/http_request.hpp>
+#include <ulocal/url_args.hpp>
+
+using namespace ::testing;
+using namespace ulocal;
+
+class TestUrlArgs : public ::testing::Test {};
+
+TEST_F(TestUrlArgs,
+ParseWithoutArgs) {
+	auto [resource, args] = UrlArgs::parse_from_resource("/endpoint");
+
+	EXPECT_EQ(resource, "/endpoint");
+	EXPECT_EQ(args.size(), 0u);
+}
+
+TEST_F(TestUrlArgs,
+ParseEmptyQuery) {
+	auto [resource, args] = UrlArgs::parse_from_resource("/endpoint?");
+
+	EXPECT_EQ(resource, "/endpoint");
+	EXPECT_EQ(args.size(), 0u);
+}
+
+TEST_F(TestUrlArgs,
+ParseArgs) {
+	auto [resource, args] = UrlArgs::parse_from_resource("/endpoint?a=1&b=x%20y&c&&d=");
+
+	EXPECT_EQ(resource, "/endpoint");
+	EXPECT_EQ(args.size(), 4u);
+	EXPECT_EQ(args.get_arg("a")->get_value(), "1");
+	EXPECT_EQ(args.get_arg("b")->get_value(), "x y");
+	EXPECT_EQ(args.get_arg("c")->get_value(), "");
+	EXPECT_EQ(args.get_arg("d")->get_value(), "");
+	EXPECT_FALSE(args.has_arg("e"));
+}
+
+TEST_F(TestUrlArgs,
+FirstArgWins) {
+	auto [resource, args] = UrlArgs::parse_from_resource("/?a=1&a=2&b%20c=3&b+c=4");
+
+	EXPECT_EQ(args.size(), 3u);
+	EXPECT_EQ(args.get_arg("a")->get_value(), "1");
+	EXPECT_EQ(args.get_arg("b c")->get_value(), "3");
+}
+
+TEST_F(TestUrlArgs,
+UnaccessedReceivedArgsAreDumpedVerbatim) {
+	auto [resource, args] = UrlArgs::parse_from_received_resource("/?blob=%41%42%43&x=%7E");
+
+	std::ostringstream ss;
+	ss << args;
+	EXPECT_EQ(ss.str(), "?blob=%41%42%43&x=%7E");
+}
+
+TEST_F(TestUrlArgs,
+CopiesOfUnaccessedArgsParseByThemselves) {
+	auto [resource, args] = UrlArgs::parse_from_received_resource("/?blob=%41%42%43&x=%7E");
+	auto copy = args;
+
+	EXPECT_EQ(copy.get_arg("blob")->get_value(), "ABC");
+	std::ostringstream ss;
+	ss << args;
+	EXPECT_EQ(ss.str(), "?blob=%41%42%43&x=%7E");
+
+	UrlArgs parsed_copy;
+	parsed_copy = copy;
+	EXPECT_EQ(parsed_copy.size(), 2u);
+	EXPECT_EQ(parsed_copy.get_arg("x")->get_value(), "~");
+}
+
+TEST_F(TestUrlArgs,
+ConcurrentFirstAccess) {
+	auto parsed = UrlArgs::parse_from_received_resource("/?a=1&b=2&c=3");
+	const auto& args = parsed.second;
+
+	// Every thread has to see all arguments no matter which one of them parses them
+	std::vector<std::thread> threads;
+	std::vector<std::size_t> sizes(8);
+	std::vector<std::string> values(8);
+	for (std::size_t i = 0; i < 8; ++i)
+	{
+		threads.emplace_back([&, i]() {
+			values[i] = args.get_arg("c")->get_value();
+			sizes[i] = args.size();
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	EXPECT_THAT(sizes, Each(3u));
+	EXPECT_THAT(values, Each("3"));
+}
+
+TEST_F(TestUrlArgs,
+AccessedArgsAreReencoded) {
+	auto [resource, args] = UrlArgs::parse_from_received_resource("/?blob=%41%42%43&x=%7E");
+	args.add_arg("y", "a b");
+
+	std::ostringstream ss;
+	ss << args;
+	EXPECT_EQ(ss.str(), "?blob=ABC&x=~&y=a%20b");
+}
+
+TEST_F(TestUrlArgs,
+ArgsOfBuiltResourceAreEncoded) {
+	auto [resource, args] = UrlArgs::parse_from_resource("/x?q=hello world&a=1&a=2");
+
+	std::ostringstream ss;
+	ss << args;
+	EXPECT_EQ(ss.str(), "?q=hello%20world&a=1");
+	EXPECT_EQ(HttpRequest("GET", "/x?q=hello world&a=1&a=2").dump(), "GET /x?q=hello%20world&a=1 HTTP/1.1\r\n\r\n");
+}
+
+TEST_F(TestUrlArgs,
+Iterate) {
+	auto [resource, args] = UrlArgs::parse_from_resource("/?b=1&a=2");
+
+	std::vector<std::string> names;
+	for (const auto& arg : args)
+		names.push_back(arg.get_name());
+
+	EXPECT_THAT(names, ElementsAre("b", "a"));
+}
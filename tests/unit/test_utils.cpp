@@ -53,10 +53,75 @@ UrlDecode) {
 	EXPECT_EQ(url_decode("ab%20"sv), "ab ");
 	EXPECT_EQ(url_decode("%20ab"sv), " ab");
 	EXPECT_EQ(url_decode("%20ab%20"sv), " ab ");
-	//EXPECT_EQ(url_decoe(), 'a');
-	//EXPECT_EQ(url_decoe(), ' ');
-	//EXPECT_EQ(url_decoe(), 'O');
-	//EXPECT_EQ(url_decoe(), 'O');
-	//EXPECT_EQ(url_decoe(), '\0');
-	//EXPECT_EQ(url_decoe(), '\xFF');
+	EXPECT_EQ(url_decode("%41%42%43"sv), "ABC");
+	EXPECT_EQ(url_decode("%4a%4A"sv), "JJ");
+	EXPECT_EQ(url_decode("%00%ff"sv), std::string("\0\xFF", 2));
+}
+
+TEST_F(TestUtils,
+UrlDecodeInvalidSequences) {
+	using namespace std::literals;
+
+	EXPECT_EQ(url_decode("ab%2"sv), "ab%2");
+	EXPECT_EQ(url_decode("ab%"sv), "ab%");
+	EXPECT_EQ(url_decode("%zz%41"sv), "%zzA");
+	EXPECT_EQ(url_decode("%%41"sv), "%A");
+}
+
+TEST_F(TestUtils,
+UrlEncode) {
+	using namespace std::literals;
+
+	EXPECT_EQ(url_encode(""sv), "");
+	EXPECT_EQ(url_encode("abc-XYZ_019.~"sv), "abc-XYZ_019.~");
+	EXPECT_EQ(url_encode("a b&c=d"sv), "a%20b%26c%3dd");
+	EXPECT_EQ(url_encode("\xFF\x80@[`{/"sv), "%ff%80%40%5b%60%7b%2f");
+}
+
+TEST_F(TestUtils,
+UrlEncodeLongRuns) {
+	std::string plain(100, 'a');
+	std::string input = plain + ' ' + plain + "/Z";
+	EXPECT_EQ(url_encode(input), plain + "%20" + plain + "%2fZ");
+
+	for (std::size_t i = 0; i < 40; ++i)
+	{
+		std::string str(40, 'x');
+		str[i] = '&';
+		EXPECT_EQ(url_decode(url_encode(str)), str);
+		EXPECT_EQ(url_encode(str).length(), 42u);
+	}
+}
+
+TEST_F(TestUtils,
+Lowercase) {
+	using namespace std::literals;
+
+	EXPECT_EQ(lowercase("Content-Length"sv), "content-length");
+	EXPECT_EQ(lowercase("ABCxyz019[@`{"sv), "abcxyz019[@`{");
+	EXPECT_EQ(lowercase("\xC4\xD6"sv), "\xC4\xD6");
+}
+
+TEST_F(TestUtils,
+IcaseEqual) {
+	EXPECT_TRUE(icase_equal("", ""));
+	EXPECT_TRUE(icase_equal("Host", "host"));
+	EXPECT_TRUE(icase_equal("Content-Length", "CONTENT-LENGTH"));
+	EXPECT_TRUE(icase_equal("Transfer-Encoding", "transfer-encoding"));
+	EXPECT_FALSE(icase_equal("Host", "Hosts"));
+	EXPECT_FALSE(icase_equal("Content-Length", "Content-Lengtx"));
+	EXPECT_FALSE(icase_equal("Content-Lengtx", "Content-Length"));
+	// Characters right next to letters in ASCII table must not be folded
+	EXPECT_FALSE(icase_equal("@[`{@[`{", "`{@[`{@["));
+	EXPECT_FALSE(icase_equal("\xC1\xC1\xC1\xC1\xC1\xC1\xC1\xC1", "\xE1\xE1\xE1\xE1\xE1\xE1\xE1\xE1"));
+}
+
+TEST_F(TestUtils,
+IcaseHash) {
+	EXPECT_EQ(icase_hash("Host"), icase_hash("hOST"));
+	EXPECT_EQ(icase_hash("Content-Length"), icase_hash("content-length"));
+	EXPECT_EQ(icase_hash("/Some/Long/Route/With/Many/Parts"), icase_hash("/some/long/route/with/many/parts"));
+	EXPECT_NE(icase_hash("Host"), icase_hash("Hosts"));
+	EXPECT_NE(icase_hash("a"), icase_hash(std::string_view{"a\0", 2}));
+	EXPECT_NE(icase_hash("Content-Length"), icase_hash("Content-Lengtx"));
 }